@@ -0,0 +1,267 @@
+#include "BitcoinExchange.hpp"
+#include "Perf.hpp"
+#include <iostream>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <stdint.h>
+
+// Throughput benchmark for the exchange: loading the rate database and
+// answering an input file against it.
+//
+// Generates an input file of random dated amounts, a share of them invalid
+// (bad dates, negative or too large amounts, missing separators, dates
+// before the first rate), then runs warm-ups and N timed repetitions of
+// loadDatabase and processInput on a fresh BitcoinExchange. The program's
+// output goes to a counting sink instead of the terminal. Reports the time
+// per phase and its latency percentiles, as a table or, with --format json,
+// as a perf report.
+
+#define PRINT(X) std::cout << X
+#define ERRLOG(X) std::cerr << X
+#define __FLUSH() ; std::cout << std::endl
+
+namespace {
+    struct Options {
+        std::string database;
+        size_t lines;
+        unsigned invalidPercent;
+        size_t reps;
+        size_t warmups;
+        uint64_t seed;
+        bool json;
+    };
+
+    enum e_phase {
+        PHASE_LOAD,
+        PHASE_PROCESS,
+        PHASE_COUNT
+    };
+
+    const char* _nsPhaseNames[] = { "load_database", "process_input" };
+
+    enum e_counter {
+        COUNTER_INPUT_LINES,
+        COUNTER_STDOUT_LINES,
+        COUNTER_STDERR_LINES,
+        COUNTER_OUTPUT_BYTES,
+        COUNTER_COUNT
+    };
+
+    const char* _nsCounterNames[] = { "input_lines", "stdout_lines", "stderr_lines", "output_bytes" };
+
+    // Discards what is written to it, counting bytes and lines.
+    class CountingBuffer : public std::streambuf {
+    public:
+        CountingBuffer() : bytes(0), lines(0) {}
+
+        uint64_t bytes;
+        uint64_t lines;
+
+    protected:
+        int overflow(int c) {
+            if (c != traits_type::eof()) {
+                ++bytes;
+                lines += c == '\n';
+            }
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char* s, std::streamsize n) {
+            bytes += n;
+            for (std::streamsize i = 0; i < n; ++i)
+                lines += s[i] == '\n';
+            return n;
+        }
+    };
+
+    std::string __generateLine(Options const& opt, Perf::Rng& rng) {
+        char buf[64];
+        int year = 2009 + static_cast<int>(rng.below(14));
+        int month = 1 + static_cast<int>(rng.below(12));
+        int day = 1 + static_cast<int>(rng.below(28));
+        double amount = rng.below(100001) / 100.0;
+
+        if (rng.below(100) >= opt.invalidPercent) {
+            std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d | %.2f", year, month, day, amount);
+            return buf;
+        }
+        switch (rng.below(5)) {
+            case 0:  std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d | %.2f", year, 13, 32, amount); break;
+            case 1:  std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d | -%.2f", year, month, day, amount); break;
+            case 2:  std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d | %.2f", year, month, day, amount + 1000.5); break;
+            case 3:  std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d %.2f", year, month, day, amount); break;
+            default: std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d | %.2f", 2008, month, day, amount); break;
+        }
+        return buf;
+    }
+
+    // Writes the input to a new temporary file; returns its path, or "" if
+    // it could not be written.
+    std::string __writeInput(Options const& opt) {
+        char path[] = "/tmp/btc_bench_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0)
+            return "";
+        close(fd);
+
+        std::ofstream out(path);
+        Perf::Rng rng(opt.seed);
+        out << "date | value\n";
+        for (size_t i = 0; i < opt.lines; ++i)
+            out << __generateLine(opt, rng) << '\n';
+        out.close();
+        if (!out) {
+            std::remove(path);
+            return "";
+        }
+        return path;
+    }
+
+    void __usage() {
+        ERRLOG("Usage:\n");
+        ERRLOG("\tbtc_bench [--db PATH] [--lines N] [--invalid PERCENT] [--reps N] [--warmup N]\n");
+        ERRLOG("\t          [--seed N] [--format text|json]") << std::endl;
+    }
+
+    bool __parseOptions(int argc, char* argv[], Options& opt) {
+        opt.database = "data.csv";
+        opt.lines = 100000;
+        opt.invalidPercent = 10;
+        opt.reps = 11;
+        opt.warmups = 2;
+        opt.seed = 42;
+        opt.json = false;
+
+        for (int i = 1; i < argc; ++i) {
+            std::string flag = argv[i];
+            if (i + 1 >= argc)
+                return false;
+            const char* val = argv[++i];
+            char* end = NULL;
+
+            if (flag == "--db") {
+                opt.database = val;
+                continue;
+            }
+            if (flag == "--format") {
+                if (std::string(val) != "text" && std::string(val) != "json")
+                    return false;
+                opt.json = std::string(val) == "json";
+                continue;
+            }
+
+            unsigned long long n = std::strtoull(val, &end, 10);
+            if (*val == '\0' || *end != '\0')
+                return false;
+            if (flag == "--lines") opt.lines = n;
+            else if (flag == "--invalid") opt.invalidPercent = n > 100 ? 100 : n;
+            else if (flag == "--reps") opt.reps = n ? n : 1;
+            else if (flag == "--warmup") opt.warmups = n;
+            else if (flag == "--seed") opt.seed = n;
+            else return false;
+        }
+        return true;
+    }
+
+    void __printRow(const char* name, Perf::Samples const& latency, double linesPerSec) {
+        std::cout.setf(std::ios::left, std::ios::adjustfield);
+        std::cout.width(16); PRINT(name);
+        std::cout.width(14); PRINT(static_cast<uint64_t>(latency.mean()));
+        std::cout.width(14); PRINT(latency.percentile(0.50));
+        std::cout.width(14); PRINT(latency.percentile(0.99));
+        std::cout.width(14); PRINT(latency.max());
+        PRINT(static_cast<uint64_t>(linesPerSec)) __FLUSH();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!__parseOptions(argc, argv, opt)) {
+        __usage();
+        return 2;
+    }
+
+    std::string input = __writeInput(opt);
+    if (input.empty()) {
+        ERRLOG("Error: could not write the generated input.") << std::endl;
+        return 1;
+    }
+
+    Perf::PhaseTimes phases(_nsPhaseNames, PHASE_COUNT);
+    Perf::Counters counters(_nsCounterNames, COUNTER_COUNT);
+    Perf::Samples latency[PHASE_COUNT];
+    CountingBuffer outSink;
+    CountingBuffer errSink;
+    bool loaded = true;
+
+    for (size_t i = 0; loaded && i < opt.warmups + opt.reps; ++i) {
+        if (i == opt.warmups) {
+            phases.clear();
+            outSink.bytes = outSink.lines = errSink.bytes = errSink.lines = 0;
+        }
+        BitcoinExchange exchange;
+        uint64_t loadNs = phases.totalNs(PHASE_LOAD);
+        uint64_t processNs = phases.totalNs(PHASE_PROCESS);
+        {
+            Perf::ScopedPhase phase(phases, PHASE_LOAD);
+            loaded = exchange.loadDatabase(opt.database);
+        }
+
+        std::streambuf* out = std::cout.rdbuf(&outSink);
+        std::streambuf* err = std::cerr.rdbuf(&errSink);
+        {
+            Perf::ScopedPhase phase(phases, PHASE_PROCESS);
+            exchange.processInput(input);
+        }
+        std::cout.rdbuf(out);
+        std::cerr.rdbuf(err);
+
+        if (i >= opt.warmups) {
+            latency[PHASE_LOAD].record(phases.totalNs(PHASE_LOAD) - loadNs);
+            latency[PHASE_PROCESS].record(phases.totalNs(PHASE_PROCESS) - processNs);
+            counters.add(COUNTER_INPUT_LINES, opt.lines);
+        }
+    }
+    std::remove(input.c_str());
+    if (!loaded) {
+        ERRLOG("Error: could not open database file `" << opt.database << "`.") << std::endl;
+        return 1;
+    }
+    counters.add(COUNTER_STDOUT_LINES, outSink.lines);
+    counters.add(COUNTER_STDERR_LINES, errSink.lines);
+    counters.add(COUNTER_OUTPUT_BYTES, outSink.bytes + errSink.bytes);
+
+    uint64_t processNs = phases.totalNs(PHASE_PROCESS);
+    double linesPerSec = processNs ? opt.lines * opt.reps * 1e9 / processNs : 0;
+
+    if (opt.json) {
+        Perf::JsonWriter json(std::cout);
+        Perf::beginReport(json, "btc_bench");
+        json.beginObject();
+        json.field("lines", opt.lines);
+        json.field("invalid_percent", opt.invalidPercent);
+        json.field("reps", opt.reps);
+        json.field("seed", opt.seed);
+        json.field("lines_per_s", linesPerSec);
+        json.field("phases", phases);
+        json.field("load_latency", latency[PHASE_LOAD]);
+        json.field("process_latency", latency[PHASE_PROCESS]);
+        json.field("counters", counters);
+        json.endObject();
+        Perf::endReport(json);
+        return 0;
+    }
+
+    PRINT("lines: " << opt.lines << " (" << opt.invalidPercent << "% invalid), reps: " << opt.reps
+          << ", seed: " << opt.seed) __FLUSH();
+    PRINT("phase           mean(ns)      p50(ns)       p99(ns)       max(ns)       lines/s") __FLUSH();
+    __printRow(_nsPhaseNames[PHASE_LOAD], latency[PHASE_LOAD], 0);
+    __printRow(_nsPhaseNames[PHASE_PROCESS], latency[PHASE_PROCESS], linesPerSec);
+    PRINT("output over " << opt.reps << " reps: " << outSink.lines << " stdout lines, " << errSink.lines
+          << " stderr lines, " << outSink.bytes + errSink.bytes << " bytes") __FLUSH();
+    return 0;
+}
@@ -0,0 +1,344 @@
+#include "BigInt.hpp"
+#include <algorithm>
+
+namespace RPN {
+    namespace {
+        typedef std::vector<uint32_t> Limbs;
+
+        const uint64_t _nsBase = 0x100000000ULL;
+        const uint32_t _nsDecimalChunk = 1000000000U; // 10^9, largest power of ten in a limb
+
+        void __trimMag(Limbs& a) {
+            while (!a.empty() && a.back() == 0)
+                a.pop_back();
+        }
+
+        Limbs __fromU64(unsigned long long v) {
+            Limbs r;
+            while (v) {
+                r.push_back(static_cast<uint32_t>(v));
+                v >>= 32;
+            }
+            return r;
+        }
+
+        int __cmpMag(Limbs const& a, Limbs const& b) {
+            if (a.size() != b.size())
+                return a.size() < b.size() ? -1 : 1;
+            for (size_t i = a.size(); i-- > 0;) {
+                if (a[i] != b[i])
+                    return a[i] < b[i] ? -1 : 1;
+            }
+            return 0;
+        }
+
+        Limbs __addMag(Limbs const& a, Limbs const& b) {
+            Limbs const& lng = a.size() >= b.size() ? a : b;
+            Limbs const& shr = a.size() >= b.size() ? b : a;
+            Limbs r(lng.size() + 1);
+            uint64_t carry = 0;
+
+            for (size_t i = 0; i < lng.size(); ++i) {
+                uint64_t s = static_cast<uint64_t>(lng[i]) + (i < shr.size() ? shr[i] : 0) + carry;
+                r[i] = static_cast<uint32_t>(s);
+                carry = s >> 32;
+            }
+            r[lng.size()] = static_cast<uint32_t>(carry);
+            __trimMag(r);
+            return r;
+        }
+
+        // Requires |a| >= |b|.
+        Limbs __subMag(Limbs const& a, Limbs const& b) {
+            Limbs r(a.size());
+            int64_t borrow = 0;
+
+            for (size_t i = 0; i < a.size(); ++i) {
+                int64_t d = static_cast<int64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+                borrow = d < 0;
+                r[i] = static_cast<uint32_t>(d + (borrow ? _nsBase : 0));
+            }
+            __trimMag(r);
+            return r;
+        }
+
+        Limbs __mulMag(Limbs const& a, Limbs const& b) {
+            if (a.empty() || b.empty())
+                return Limbs();
+
+            Limbs r(a.size() + b.size(), 0);
+            for (size_t i = 0; i < a.size(); ++i) {
+                uint64_t carry = 0;
+                for (size_t j = 0; j < b.size(); ++j) {
+                    uint64_t t = static_cast<uint64_t>(a[i]) * b[j] + r[i + j] + carry;
+                    r[i + j] = static_cast<uint32_t>(t);
+                    carry = t >> 32;
+                }
+                r[i + b.size()] = static_cast<uint32_t>(carry);
+            }
+            __trimMag(r);
+            return r;
+        }
+
+        void __mulAddSmall(Limbs& a, uint32_t mul, uint32_t add) {
+            uint64_t carry = add;
+            for (size_t i = 0; i < a.size(); ++i) {
+                uint64_t t = static_cast<uint64_t>(a[i]) * mul + carry;
+                a[i] = static_cast<uint32_t>(t);
+                carry = t >> 32;
+            }
+            if (carry)
+                a.push_back(static_cast<uint32_t>(carry));
+        }
+
+        uint32_t __divSmall(Limbs& a, uint32_t d) {
+            uint64_t rem = 0;
+            for (size_t i = a.size(); i-- > 0;) {
+                uint64_t cur = (rem << 32) | a[i];
+                a[i] = static_cast<uint32_t>(cur / d);
+                rem = cur % d;
+            }
+            __trimMag(a);
+            return static_cast<uint32_t>(rem);
+        }
+
+        Limbs __shiftLeft(Limbs const& a, unsigned s, size_t extra) {
+            Limbs r(a.size() + extra, 0);
+            for (size_t i = 0; i < a.size(); ++i) {
+                uint64_t cur = static_cast<uint64_t>(a[i]) << s;
+                r[i] |= static_cast<uint32_t>(cur);
+                if (i + 1 < r.size())
+                    r[i + 1] |= static_cast<uint32_t>(cur >> 32);
+            }
+            return r;
+        }
+
+        // Knuth, TAOCP vol. 2, 4.3.1, algorithm D. Requires b.size() >= 2.
+        Limbs __divMag(Limbs const& a, Limbs const& b) {
+            if (__cmpMag(a, b) < 0)
+                return Limbs();
+
+            const size_t n = b.size();
+            const size_t m = a.size();
+            const unsigned s = __builtin_clz(b.back());
+
+            Limbs v = __shiftLeft(b, s, 0);
+            Limbs u = __shiftLeft(a, s, 1);
+            Limbs q(m - n + 1, 0);
+
+            for (size_t j = m - n + 1; j-- > 0;) {
+                uint64_t num = (static_cast<uint64_t>(u[j + n]) << 32) | u[j + n - 1];
+                uint64_t qhat = num / v[n - 1];
+                uint64_t rhat = num % v[n - 1];
+
+                while (qhat >= _nsBase || qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+                    --qhat;
+                    rhat += v[n - 1];
+                    if (rhat >= _nsBase)
+                        break;
+                }
+
+                int64_t k = 0;
+                int64_t t;
+                for (size_t i = 0; i < n; ++i) {
+                    uint64_t p = qhat * v[i];
+                    t = static_cast<int64_t>(u[i + j]) - k - static_cast<int64_t>(p & 0xFFFFFFFFULL);
+                    u[i + j] = static_cast<uint32_t>(t);
+                    k = static_cast<int64_t>(p >> 32) - (t >> 32);
+                }
+                t = static_cast<int64_t>(u[j + n]) - k;
+                u[j + n] = static_cast<uint32_t>(t);
+
+                q[j] = static_cast<uint32_t>(qhat);
+                if (t < 0) { // qhat was one too large: add v back
+                    --q[j];
+                    uint64_t c = 0;
+                    for (size_t i = 0; i < n; ++i) {
+                        uint64_t sum = static_cast<uint64_t>(u[i + j]) + v[i] + c;
+                        u[i + j] = static_cast<uint32_t>(sum);
+                        c = sum >> 32;
+                    }
+                    u[j + n] += static_cast<uint32_t>(c);
+                }
+            }
+            __trimMag(q);
+            return q;
+        }
+    }
+
+    BigInt::BigInt() : _mag(), _neg(false) {}
+
+    BigInt::BigInt(long long value) : _mag(), _neg(value < 0) {
+        unsigned long long m = static_cast<unsigned long long>(value);
+        _mag = __fromU64(_neg ? 0ULL - m : m);
+    }
+
+#if defined(_RPN_HAS_INT128)
+    BigInt::BigInt(rpn_int128_t value) : _mag(), _neg(value < 0) {
+        rpn_uint128_t m = static_cast<rpn_uint128_t>(value);
+        if (_neg)
+            m = 0 - m;
+        while (m) {
+            _mag.push_back(static_cast<uint32_t>(m));
+            m >>= 32;
+        }
+    }
+#endif
+
+    bool BigInt::parse(const char* str, size_t len, BigInt& out) {
+        size_t i = 0;
+        bool neg = false;
+
+        if (i < len && (str[i] == '+' || str[i] == '-')) {
+            neg = str[i] == '-';
+            ++i;
+        }
+        if (i == len)
+            return false;
+
+        Limbs mag;
+        while (i < len) {
+            uint32_t chunk = 0;
+            uint32_t scale = 1;
+            for (int d = 0; d < 9 && i < len; ++d, ++i) {
+                if (str[i] < '0' || str[i] > '9')
+                    return false;
+                chunk = chunk * 10 + (str[i] - '0');
+                scale *= 10;
+            }
+            __mulAddSmall(mag, scale, chunk);
+        }
+        __trimMag(mag);
+
+        out._mag.swap(mag);
+        out._neg = neg;
+        out.trim_impl();
+        return true;
+    }
+
+    bool BigInt::isZero() const { return _mag.empty(); }
+    bool BigInt::isNegative() const { return _neg; }
+
+    bool BigInt::toInt64(long long& out) const {
+        if (_mag.size() > 2)
+            return false;
+
+        unsigned long long m = 0;
+        for (size_t i = _mag.size(); i-- > 0;)
+            m = (m << 32) | _mag[i];
+
+        const unsigned long long limit = 0x8000000000000000ULL;
+        if (m > limit || (m == limit && !_neg))
+            return false;
+        out = _neg ? static_cast<long long>(0ULL - m) : static_cast<long long>(m);
+        return true;
+    }
+
+#if defined(_RPN_HAS_INT128)
+    bool BigInt::toInt128(rpn_int128_t& out) const {
+        if (_mag.size() > 4)
+            return false;
+
+        rpn_uint128_t m = 0;
+        for (size_t i = _mag.size(); i-- > 0;)
+            m = (m << 32) | _mag[i];
+
+        const rpn_uint128_t limit = static_cast<rpn_uint128_t>(1) << 127;
+        if (m > limit || (m == limit && !_neg))
+            return false;
+        out = _neg ? static_cast<rpn_int128_t>(0 - m) : static_cast<rpn_int128_t>(m);
+        return true;
+    }
+#endif
+
+    std::string BigInt::toString() const {
+        if (_mag.empty())
+            return "0";
+
+        Limbs work(_mag);
+        std::vector<uint32_t> chunks;
+        while (!work.empty())
+            chunks.push_back(__divSmall(work, _nsDecimalChunk));
+
+        std::string out = _neg ? "-" : "";
+        char buf[16];
+        for (size_t i = chunks.size(); i-- > 0;) {
+            uint32_t c = chunks[i];
+            int w = 0;
+            do {
+                buf[w++] = static_cast<char>('0' + c % 10);
+                c /= 10;
+            } while (c);
+            if (i + 1 != chunks.size()) {
+                while (w < 9)
+                    buf[w++] = '0';
+            }
+            while (w > 0)
+                out += buf[--w];
+        }
+        return out;
+    }
+
+    BigInt BigInt::operator-() const {
+        BigInt r(*this);
+        r._neg = !_neg;
+        r.trim_impl();
+        return r;
+    }
+
+    BigInt BigInt::operator+(BigInt const& rhs) const {
+        BigInt r;
+        if (_neg == rhs._neg) {
+            r._mag = __addMag(_mag, rhs._mag);
+            r._neg = _neg;
+        } else if (__cmpMag(_mag, rhs._mag) >= 0) {
+            r._mag = __subMag(_mag, rhs._mag);
+            r._neg = _neg;
+        } else {
+            r._mag = __subMag(rhs._mag, _mag);
+            r._neg = rhs._neg;
+        }
+        r.trim_impl();
+        return r;
+    }
+
+    BigInt BigInt::operator-(BigInt const& rhs) const {
+        return *this + (-rhs);
+    }
+
+    BigInt BigInt::operator*(BigInt const& rhs) const {
+        BigInt r;
+        r._mag = __mulMag(_mag, rhs._mag);
+        r._neg = _neg != rhs._neg;
+        r.trim_impl();
+        return r;
+    }
+
+    BigInt BigInt::operator/(BigInt const& rhs) const {
+        BigInt r;
+        if (rhs._mag.size() == 1) {
+            r._mag = _mag;
+            __divSmall(r._mag, rhs._mag[0]);
+        } else {
+            r._mag = __divMag(_mag, rhs._mag);
+        }
+        r._neg = _neg != rhs._neg;
+        r.trim_impl();
+        return r;
+    }
+
+    bool BigInt::operator==(BigInt const& rhs) const {
+        return _neg == rhs._neg && _mag == rhs._mag;
+    }
+
+    bool BigInt::operator!=(BigInt const& rhs) const {
+        return !(*this == rhs);
+    }
+
+    // Keeps the representation canonical: no leading zero limbs, no negative zero.
+    void BigInt::trim_impl() {
+        __trimMag(_mag);
+        if (_mag.empty())
+            _neg = false;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#if defined(__SIZEOF_INT128__)
+#   define _RPN_HAS_INT128
+typedef __int128 rpn_int128_t;
+typedef unsigned __int128 rpn_uint128_t;
+#endif
+
+namespace RPN {
+    // Arbitrary-precision signed integer: sign + magnitude, base 2^32 limbs,
+    // least significant limb first. Zero is an empty magnitude.
+    // Division truncates toward zero, like the built-in integer types.
+    class BigInt {
+    public:
+        BigInt();
+        BigInt(long long value);
+#if defined(_RPN_HAS_INT128)
+        BigInt(rpn_int128_t value);
+#endif
+
+        // Accepts [+-]?[0-9]+ and nothing else.
+        static bool parse(const char* str, size_t len, BigInt& out);
+
+        bool isZero() const;
+        bool isNegative() const;
+        bool toInt64(long long& out) const;
+#if defined(_RPN_HAS_INT128)
+        bool toInt128(rpn_int128_t& out) const;
+#endif
+        std::string toString() const;
+
+        BigInt operator-() const;
+        BigInt operator+(BigInt const& rhs) const;
+        BigInt operator-(BigInt const& rhs) const;
+        BigInt operator*(BigInt const& rhs) const;
+        BigInt operator/(BigInt const& rhs) const; // rhs must not be zero
+
+        bool operator==(BigInt const& rhs) const;
+        bool operator!=(BigInt const& rhs) const;
+
+    private:
+        typedef std::vector<uint32_t> Limbs;
+
+        Limbs _mag;
+        bool _neg;
+
+        void trim_impl();
+    };
+}
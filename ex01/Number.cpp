@@ -0,0 +1,136 @@
+#include "Number.hpp"
+
+namespace RPN {
+    namespace {
+#if defined(_RPN_HAS_INT128)
+        const rpn_int128_t _nsWideMin = static_cast<rpn_int128_t>(static_cast<rpn_uint128_t>(1) << 127);
+
+        bool __wideOp(rpn_int128_t a, rpn_int128_t b, int op, rpn_int128_t& r) {
+            switch (op) {
+            case 0: return !__builtin_add_overflow(a, b, &r);
+            case 1: return !__builtin_sub_overflow(a, b, &r);
+            case 2: return !__builtin_mul_overflow(a, b, &r);
+            default:
+                if (b == -1 && a == _nsWideMin)
+                    return false;
+                r = a / b;
+                return true;
+            }
+        }
+#endif
+    }
+
+    bool Number::parse(const char* str, size_t len, Number& out) {
+        size_t i = (len > 0 && (str[0] == '+' || str[0] == '-')) ? 1 : 0;
+
+        if (i < len && len - i <= 18) { // cannot overflow a long long
+            long long v = 0;
+            for (size_t j = i; j < len; ++j) {
+                if (str[j] < '0' || str[j] > '9')
+                    return false;
+                v = v * 10 + (str[j] - '0');
+            }
+            out = Number(str[0] == '-' ? -v : v);
+            return true;
+        }
+
+        BigInt big;
+        if (!BigInt::parse(str, len, big))
+            return false;
+        out = fromBig_impl(big);
+        return true;
+    }
+
+    Number::Tier Number::tier() const { return _tier; }
+
+    bool Number::isZero() const {
+        return _tier == SMALL && _small == 0;
+    }
+
+    bool Number::toInt(int& out) const {
+        if (_tier != SMALL || _small < INT_MIN || _small > INT_MAX)
+            return false;
+        out = static_cast<int>(_small);
+        return true;
+    }
+
+    BigInt Number::toBigInt() const {
+        switch (_tier) {
+        case SMALL: return BigInt(_small);
+#if defined(_RPN_HAS_INT128)
+        case WIDE: return BigInt(_wide);
+#endif
+        default: return _big;
+        }
+    }
+
+    std::string Number::toString() const {
+        return toBigInt().toString();
+    }
+
+    bool Number::operator==(Number const& rhs) const {
+        if (_tier != rhs._tier)
+            return false; // representations are canonical
+        switch (_tier) {
+        case SMALL: return _small == rhs._small;
+#if defined(_RPN_HAS_INT128)
+        case WIDE: return _wide == rhs._wide;
+#endif
+        default: return _big == rhs._big;
+        }
+    }
+
+    bool Number::operator!=(Number const& rhs) const {
+        return !(*this == rhs);
+    }
+
+    Number Number::slowPath_impl(Number const& a, Number const& b, Op op) {
+#if defined(_RPN_HAS_INT128)
+        if (a._tier != BIG && b._tier != BIG) {
+            rpn_int128_t wa = a._tier == SMALL ? a._small : a._wide;
+            rpn_int128_t wb = b._tier == SMALL ? b._small : b._wide;
+            rpn_int128_t wr;
+
+            if (__wideOp(wa, wb, op, wr)) {
+                Number r;
+                if (wr >= LLONG_MIN && wr <= LLONG_MAX) {
+                    r._small = static_cast<long long>(wr);
+                } else {
+                    r._tier = WIDE;
+                    r._wide = wr;
+                }
+                return r;
+            }
+        }
+#endif
+        BigInt ba = a.toBigInt();
+        BigInt bb = b.toBigInt();
+
+        switch (op) {
+        case ADD: return fromBig_impl(ba + bb);
+        case SUB: return fromBig_impl(ba - bb);
+        case MUL: return fromBig_impl(ba * bb);
+        default: return fromBig_impl(ba / bb);
+        }
+    }
+
+    // Picks the smallest tier that holds the value.
+    Number Number::fromBig_impl(BigInt const& value) {
+        Number r;
+        if (value.toInt64(r._small))
+            return r;
+#if defined(_RPN_HAS_INT128)
+        if (value.toInt128(r._wide)) {
+            r._tier = WIDE;
+            return r;
+        }
+#endif
+        r._tier = BIG;
+        r._big = value;
+        return r;
+    }
+
+    std::ostream& operator<<(std::ostream& os, Number const& n) {
+        return os << n.toString();
+    }
+}
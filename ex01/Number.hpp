@@ -0,0 +1,103 @@
+#pragma once
+
+#include "BigInt.hpp"
+#include <ostream>
+#include <climits>
+
+namespace RPN {
+    // Integer value of the wide arithmetic mode.
+    //
+    // Values live in a native 64-bit integer and only move up a tier when an
+    // operation overflows: SMALL (long long) -> WIDE (128-bit, when the compiler
+    // has it) -> BIG (BigInt). Results are demoted back to the smallest tier that
+    // holds them, so a single huge intermediate does not slow down the rest of
+    // the expression. The SMALL/SMALL case is inlined and costs one overflow
+    // check per operation.
+    class Number {
+    public:
+        enum Tier {
+            SMALL,
+            WIDE,
+            BIG
+        };
+
+        Number();
+        explicit Number(long long value);
+
+        // Accepts [+-]?[0-9]+ of any length.
+        static bool parse(const char* str, size_t len, Number& out);
+
+        Tier tier() const;
+        bool isZero() const;
+        bool toInt(int& out) const;
+        BigInt toBigInt() const;
+        std::string toString() const;
+
+        friend Number operator+(Number const& a, Number const& b);
+        friend Number operator-(Number const& a, Number const& b);
+        friend Number operator*(Number const& a, Number const& b);
+        friend Number operator/(Number const& a, Number const& b); // b must not be zero
+
+        bool operator==(Number const& rhs) const;
+        bool operator!=(Number const& rhs) const;
+
+    private:
+        enum Op { ADD, SUB, MUL, DIV };
+
+        Tier _tier;
+        long long _small;
+#if defined(_RPN_HAS_INT128)
+        rpn_int128_t _wide;
+#endif
+        BigInt _big;
+
+        static Number slowPath_impl(Number const& a, Number const& b, Op op);
+        static Number fromBig_impl(BigInt const& value);
+    };
+
+    std::ostream& operator<<(std::ostream& os, Number const& n);
+
+    inline Number::Number() : _tier(SMALL), _small(0), _big() {
+#if defined(_RPN_HAS_INT128)
+        _wide = 0;
+#endif
+    }
+
+    inline Number::Number(long long value) : _tier(SMALL), _small(value), _big() {
+#if defined(_RPN_HAS_INT128)
+        _wide = 0;
+#endif
+    }
+
+    inline Number operator+(Number const& a, Number const& b) {
+        long long r;
+        if (a._tier == Number::SMALL && b._tier == Number::SMALL
+            && !__builtin_add_overflow(a._small, b._small, &r))
+            return Number(r);
+        return Number::slowPath_impl(a, b, Number::ADD);
+    }
+
+    inline Number operator-(Number const& a, Number const& b) {
+        long long r;
+        if (a._tier == Number::SMALL && b._tier == Number::SMALL
+            && !__builtin_sub_overflow(a._small, b._small, &r))
+            return Number(r);
+        return Number::slowPath_impl(a, b, Number::SUB);
+    }
+
+    inline Number operator*(Number const& a, Number const& b) {
+        long long r;
+        if (a._tier == Number::SMALL && b._tier == Number::SMALL
+            && !__builtin_mul_overflow(a._small, b._small, &r))
+            return Number(r);
+        return Number::slowPath_impl(a, b, Number::MUL);
+    }
+
+    inline Number operator/(Number const& a, Number const& b) {
+        // LLONG_MIN / -1 is the only quotient that overflows.
+        if (a._tier == Number::SMALL && b._tier == Number::SMALL
+            && !(b._small == -1 && a._small == LLONG_MIN))
+            return Number(a._small / b._small);
+        return Number::slowPath_impl(a, b, Number::DIV);
+    }
+}
@@ -1,7 +1,8 @@
 #include "RPN.hpp"
-#include <stack>
+#include <vector>
 #include <cstring>
-#include <sstream>
+#include <climits>
+#include <istream>
 #include <cstdlib>
 
 namespace RPN {
@@ -20,14 +21,29 @@ namespace RPN {
     InvalidTokenError::~InvalidTokenError() throw () {}
     ExtraOperandsError::ExtraOperandsError() : RPNException("Extra operands left on stack") {}
     ExtraOperandsError::~ExtraOperandsError() throw() {}
-    
+    OverflowError::OverflowError() : RPNException("Result does not fit in an int") {}
+    OverflowError::~OverflowError() throw() {}
+
     namespace {
-        std::stack<int> _nsInternalS;
+        IntStack _nsInternalS;
+        WideStack _nsInternalW;
+        ArithmeticMode _nsInternalMode = INT_ARITHMETIC;
+        ResultCache* _nsInternalCache = NULL;
+
+        enum e_error_codes {
+            NO_ERROR,
+            DIVISION_BY_ZERO,
+            STACK_UNDERFLOW,
+            INVALID_TOKEN
+        };
 
         void __clearStack() {
             while (!_nsInternalS.empty()) {
                 _nsInternalS.pop();
             }
+            while (!_nsInternalW.empty()) {
+                _nsInternalW.pop();
+            }
         }
 
         void __ensureOperands() {
@@ -42,6 +58,12 @@ namespace RPN {
             return ret;
         }
 
+        Number __popWideOperand() {
+            Number ret = _nsInternalW.top();
+            _nsInternalW.pop();
+            return ret;
+        }
+
         int __iadd(int a, int b) { return a + b; }
         int __isub(int a, int b) { return a - b; }
         int __imul(int a, int b) { return a * b; }
@@ -55,17 +77,62 @@ namespace RPN {
                     c == '*' || c == '/');
         }
 
-    }
+        void __processWideToken(const char* token, size_t len) {
+            if (len == 1 && __isOperator(token[0])) {
+                if (_nsInternalW.size() < 2) {
+                    throw StackUnderflowError();
+                }
+                Number b = __popWideOperand();
+                Number a = __popWideOperand();
 
-    void processExpression(std::string const & expr) {
-        __clearStack();
-        std::istringstream iss(expr);
-        std::string token;
+                switch (token[0]) {
+                case '+': _nsInternalW.push(a + b); break;
+                case '-': _nsInternalW.push(a - b); break;
+                case '*': _nsInternalW.push(a * b); break;
+                case '/':
+                    if (b.isZero()) throw DivisionByZeroError();
+                    _nsInternalW.push(a / b);
+                    break;
+                }
+            } else {
+                Number value;
+                if (!Number::parse(token, len, value)) {
+                    throw InvalidTokenError();
+                }
+                _nsInternalW.push(value);
+            }
+        }
 
-        while (iss >> token) {
-            if (token.empty()) continue;
+        // Same rules as `std::istream >> int`: optional sign, digits, no overflow.
+        bool __parseInt(const char* token, size_t len, int& out) {
+            size_t i = (token[0] == '+' || token[0] == '-') ? 1 : 0;
+            bool neg = token[0] == '-';
+            long long value = 0;
+
+            if (i == len)
+                return false;
+            for (; i < len; ++i) {
+                if (token[i] < '0' || token[i] > '9')
+                    return false;
+                value = value * 10 + (token[i] - '0');
+                if (value > static_cast<long long>(INT_MAX) + 1)
+                    return false;
+            }
+            if (neg)
+                value = -value;
+            if (value < INT_MIN || value > INT_MAX)
+                return false;
+            out = static_cast<int>(value);
+            return true;
+        }
+
+        void __processToken(const char* token, size_t len) {
+            if (_nsInternalMode == WIDE_ARITHMETIC) {
+                __processWideToken(token, len);
+                return;
+            }
 
-            if (token.length() == 1 && __isOperator(token[0])) {
+            if (len == 1 && __isOperator(token[0])) {
                 __ensureOperands();
                 int b = __popOperand();
                 int a = __popOperand();
@@ -77,17 +144,187 @@ namespace RPN {
                 case '/': _nsInternalS.push(__idiv(a, b)); break;
                 }
             } else {
-                std::istringstream numStream(token);
                 int value;
-                if (!(numStream >> value) || !(numStream >> std::ws).eof()) {
+                if (!__parseInt(token, len, value)) {
                     throw InvalidTokenError();
                 }
                 _nsInternalS.push(value);
             }
         }
+
+        // std::isspace in the "C" locale, without the per-character call.
+        bool __isSpace(char c) {
+            return c == ' ' || (c >= '\t' && c <= '\r');
+        }
+
+        // Evaluates every complete token in [buf, buf + len). A token touching
+        // the end of the buffer may continue in the next one, so it is kept in
+        // `carry` instead; call __flushCarry once the input is exhausted.
+        void __feed(const char* buf, size_t len, std::string& carry) {
+            size_t i = 0;
+
+            if (!carry.empty()) {
+                while (i < len && !__isSpace(buf[i]))
+                    ++i;
+                carry.append(buf, i);
+                if (i == len)
+                    return;
+                __processToken(carry.data(), carry.size());
+                carry.clear();
+            }
+
+            while (i < len) {
+                while (i < len && __isSpace(buf[i]))
+                    ++i;
+                size_t start = i;
+                while (i < len && !__isSpace(buf[i]))
+                    ++i;
+                if (i == start)
+                    break;
+                if (i == len) {
+                    carry.assign(buf + start, i - start);
+                    break;
+                }
+                __processToken(buf + start, i - start);
+            }
+        }
+
+        void __flushCarry(std::string& carry) {
+            if (!carry.empty()) {
+                __processToken(carry.data(), carry.size());
+                carry.clear();
+            }
+        }
+
+        // Cache key: arithmetic mode, then the tokens separated by single spaces.
+        void __normalize(std::string const & expr, std::string& key) {
+            key.resize(expr.size() + 2);
+            char* out = &key[0];
+            *out++ = _nsInternalMode == WIDE_ARITHMETIC ? 'w' : 'i';
+
+            bool pendingSpace = false;
+            for (size_t i = 0; i < expr.size(); ++i) {
+                char c = expr[i];
+                if (__isSpace(c)) {
+                    pendingSpace = true;
+                    continue;
+                }
+                if (pendingSpace || out == &key[1]) {
+                    *out++ = ' ';
+                    pendingSpace = false;
+                }
+                *out++ = c;
+            }
+            key.resize(out - &key[0]);
+        }
+
+        void __replay(CachedResult const & cached) {
+            switch (cached.error) {
+            case DIVISION_BY_ZERO: throw DivisionByZeroError();
+            case STACK_UNDERFLOW: throw StackUnderflowError();
+            case INVALID_TOKEN: throw InvalidTokenError();
+            }
+            _nsInternalS = cached.intStack;
+            _nsInternalW = cached.wideStack;
+        }
+
+        void __processCached(std::string const & expr) {
+            static std::string key; // reused so lookups do not allocate
+            __normalize(expr, key);
+            uint64_t keyHash = ResultCache::hash(key.data(), key.size());
+
+            CachedResult const* hit = _nsInternalCache->find(keyHash, key);
+            if (hit) {
+                __replay(*hit);
+                return;
+            }
+
+            CachedResult result;
+            result.error = NO_ERROR;
+            try {
+                std::string carry;
+                __feed(key.data() + 1, key.size() - 1, carry);
+                __flushCarry(carry);
+            } catch (const DivisionByZeroError&) {
+                result.error = DIVISION_BY_ZERO;
+            } catch (const StackUnderflowError&) {
+                result.error = STACK_UNDERFLOW;
+            } catch (const InvalidTokenError&) {
+                result.error = INVALID_TOKEN;
+            }
+
+            if (result.error == NO_ERROR) {
+                result.intStack = _nsInternalS;
+                result.wideStack = _nsInternalW;
+            }
+            _nsInternalCache->insert(keyHash, key, result);
+            __replay(result);
+        }
+
+    }
+
+    void setArithmeticMode(ArithmeticMode mode) {
+        __clearStack();
+        _nsInternalMode = mode;
+    }
+
+    ArithmeticMode getArithmeticMode() {
+        return _nsInternalMode;
+    }
+
+    void setCacheCapacity(size_t entries) {
+        delete _nsInternalCache;
+        _nsInternalCache = entries ? new ResultCache(entries) : NULL;
+    }
+
+    CacheStats getCacheStats() {
+        if (_nsInternalCache) {
+            return _nsInternalCache->stats();
+        }
+        CacheStats none = { 0, 0, 0, 0, 0 };
+        return none;
+    }
+
+    void processExpression(std::string const & expr) {
+        __clearStack();
+        if (_nsInternalCache) {
+            __processCached(expr);
+            return;
+        }
+
+        std::string carry;
+
+        __feed(expr.data(), expr.size(), carry);
+        __flushCarry(carry);
+    }
+
+    void processStream(std::istream& in, size_t bufferSize) {
+        __clearStack();
+        std::vector<char> buf(bufferSize ? bufferSize : 1);
+        std::string carry;
+
+        while (in) {
+            in.read(&buf[0], buf.size());
+            std::streamsize got = in.gcount();
+            if (got <= 0)
+                break;
+            __feed(&buf[0], static_cast<size_t>(got), carry);
+        }
+        if (in.bad()) {
+            throw std::ios_base::failure("Error reading expression stream");
+        }
+        __flushCarry(carry);
     }
 
     int getResult() {
+        if (_nsInternalMode == WIDE_ARITHMETIC) {
+            int result;
+            if (!getWideResult().toInt(result)) {
+                throw OverflowError();
+            }
+            return result;
+        }
+
         if (_nsInternalS.empty()) {
             throw StackUnderflowError();
         }
@@ -100,4 +337,18 @@ namespace RPN {
         
         return result;
     }
-}
+
+    Number getWideResult() {
+        if (_nsInternalW.empty()) {
+            throw StackUnderflowError();
+        }
+        Number result = _nsInternalW.top();
+        _nsInternalW.pop();
+
+        if (!_nsInternalW.empty()) {
+            throw ExtraOperandsError();
+        }
+
+        return result;
+    }
+}
\ No newline at end of file
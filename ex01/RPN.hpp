@@ -2,6 +2,9 @@
 
 #include <string>
 #include <exception>
+#include <iosfwd>
+#include "Number.hpp"
+#include "ResultCache.hpp"
 
 namespace RPN {
     class RPNException : public std::exception {
@@ -38,6 +41,34 @@ namespace RPN {
         virtual ~ExtraOperandsError() throw();
     };
 
+    class OverflowError : public RPNException {
+    public:
+        OverflowError();
+        virtual ~OverflowError() throw();
+    };
+
+    // INT_ARITHMETIC evaluates in plain `int` (the default).
+    // WIDE_ARITHMETIC evaluates in `Number`, which never overflows.
+    enum ArithmeticMode {
+        INT_ARITHMETIC,
+        WIDE_ARITHMETIC
+    };
+
+    void setArithmeticMode(ArithmeticMode mode);
+    ArithmeticMode getArithmeticMode();
+
+    // Memoizes processExpression outcomes (results and errors) for up to
+    // `entries` distinct expressions. Expressions that differ only in
+    // whitespace share an entry. 0 disables the cache, which is the default.
+    void setCacheCapacity(size_t entries);
+    CacheStats getCacheStats();
+
     void processExpression(std::string const & expr);
-    int getResult();
+
+    // Evaluates an expression read from `in` in chunks of `bufferSize` bytes,
+    // so memory use is bounded by the operand stack, not by the input length.
+    void processStream(std::istream& in, size_t bufferSize = 64 * 1024);
+
+    int getResult(); // throws OverflowError if a wide result does not fit in an int
+    Number getWideResult();
 }
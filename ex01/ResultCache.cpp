@@ -0,0 +1,130 @@
+#include "ResultCache.hpp"
+#include <cstring>
+
+namespace RPN {
+    ResultCache::ResultCache(size_t capacity)
+        : _slots(capacity ? capacity : 1), _index(), _mask(0), _hand(0),
+          _entries(0), _hits(0), _misses(0), _evictions(0) {
+        size_t buckets = 2;
+        while (buckets < 2 * _slots.size())
+            buckets <<= 1;
+        _index.assign(buckets, 0);
+        _mask = buckets - 1;
+
+        for (size_t i = 0; i < _slots.size(); ++i) {
+            _slots[i].hash = 0;
+            _slots[i].referenced = false;
+        }
+    }
+
+    // Multiplicative hash over 8-byte words with a final avalanche step.
+    // Keys are short token strings, so per-byte FNV was the lookup bottleneck.
+    uint64_t ResultCache::hash(const char* data, size_t len) {
+        uint64_t h = 0x9E3779B97F4A7C15ULL ^ len;
+        size_t i = 0;
+
+        for (; i + 8 <= len; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, data + i, sizeof(w));
+            h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+            h ^= h >> 32;
+        }
+        if (i < len) {
+            uint64_t w = 0;
+            std::memcpy(&w, data + i, len - i);
+            h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        }
+
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 32;
+        return h;
+    }
+
+    CachedResult const* ResultCache::find(uint64_t keyHash, std::string const& key) {
+        size_t pos = probe_impl(keyHash, key);
+        if (_index[pos] == 0) {
+            ++_misses;
+            return NULL;
+        }
+
+        Slot& slot = _slots[_index[pos] - 1];
+        slot.referenced = true;
+        ++_hits;
+        return &slot.result;
+    }
+
+    void ResultCache::insert(uint64_t keyHash, std::string const& key, CachedResult const& result) {
+        size_t pos = probe_impl(keyHash, key);
+        if (_index[pos] != 0) {
+            _slots[_index[pos] - 1].result = result;
+            return;
+        }
+
+        size_t victim;
+        if (_entries < _slots.size()) {
+            victim = _entries++;
+        } else {
+            // Second chance: skip (and clear) entries hit since the last sweep.
+            while (_slots[_hand].referenced) {
+                _slots[_hand].referenced = false;
+                _hand = (_hand + 1) % _slots.size();
+            }
+            victim = _hand;
+            _hand = (_hand + 1) % _slots.size();
+            unindex_impl(victim);
+            ++_evictions;
+            pos = probe_impl(keyHash, key);
+        }
+
+        Slot& slot = _slots[victim];
+        slot.hash = keyHash;
+        slot.key = key;
+        slot.result = result;
+        slot.referenced = false;
+        _index[pos] = victim + 1;
+    }
+
+    CacheStats ResultCache::stats() const {
+        CacheStats s;
+        s.hits = _hits;
+        s.misses = _misses;
+        s.evictions = _evictions;
+        s.entries = _entries;
+        s.capacity = _slots.size();
+        return s;
+    }
+
+    // Index position holding `key`, or the empty position where it would go.
+    size_t ResultCache::probe_impl(uint64_t keyHash, std::string const& key) const {
+        size_t pos = keyHash & _mask;
+        while (_index[pos] != 0) {
+            Slot const& slot = _slots[_index[pos] - 1];
+            if (slot.hash == keyHash && slot.key == key)
+                break;
+            pos = (pos + 1) & _mask;
+        }
+        return pos;
+    }
+
+    // Backward-shift deletion keeps linear probing chains intact without tombstones.
+    void ResultCache::unindex_impl(size_t slot) {
+        size_t i = _slots[slot].hash & _mask;
+        while (_index[i] != slot + 1)
+            i = (i + 1) & _mask;
+
+        size_t j = i;
+        while (true) {
+            j = (j + 1) & _mask;
+            if (_index[j] == 0)
+                break;
+            size_t home = _slots[_index[j] - 1].hash & _mask;
+            bool inGap = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+            if (inGap)
+                continue;
+            _index[i] = _index[j];
+            i = j;
+        }
+        _index[i] = 0;
+    }
+}
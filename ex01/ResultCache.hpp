@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Number.hpp"
+#include <string>
+#include <vector>
+#include <stack>
+#include <stdint.h>
+
+namespace RPN {
+    typedef std::stack<int, std::vector<int> > IntStack;
+    typedef std::stack<Number, std::vector<Number> > WideStack;
+
+    struct CacheStats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t entries;
+        size_t capacity;
+    };
+
+    // Outcome of one evaluation: either the error it raised, or the operand
+    // stack it left behind, so getResult() behaves the same on a hit as after
+    // a real evaluation.
+    struct CachedResult {
+        int error; // 0 when the evaluation did not throw
+        IntStack intStack;
+        WideStack wideStack;
+    };
+
+    // Fixed-capacity map from normalized expression to CachedResult, with
+    // CLOCK (second chance) eviction. Keys are looked up through an open
+    // addressing index on their 64-bit hash and compared in full on a match.
+    class ResultCache {
+    public:
+        explicit ResultCache(size_t capacity);
+
+        static uint64_t hash(const char* data, size_t len);
+
+        CachedResult const* find(uint64_t keyHash, std::string const& key);
+        void insert(uint64_t keyHash, std::string const& key, CachedResult const& result);
+
+        CacheStats stats() const;
+
+    private:
+        struct Slot {
+            uint64_t hash;
+            std::string key;
+            CachedResult result;
+            bool referenced;
+        };
+
+        std::vector<Slot> _slots;
+        std::vector<size_t> _index; // slot + 1, 0 when empty
+        size_t _mask;
+        size_t _hand;
+        size_t _entries;
+        size_t _hits;
+        size_t _misses;
+        size_t _evictions;
+
+        size_t probe_impl(uint64_t keyHash, std::string const& key) const;
+        void unindex_impl(size_t slot);
+
+        ResultCache(const ResultCache& other);
+        ResultCache& operator=(const ResultCache& rhs);
+    };
+}
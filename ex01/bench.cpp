@@ -0,0 +1,577 @@
+#include "RPN.hpp"
+#include "Perf.hpp"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <stdint.h>
+
+// Throughput benchmark and differential fuzzer for the RPN evaluator.
+//
+// Generates random valid and invalid expressions, runs each one through every
+// evaluation mode (int/wide x string/stream/cached), checks the outcome against a
+// reference evaluator, and reports expressions/s, tokens/s and latency
+// percentiles per mode, as a table or, with --format json, as a perf report
+// with the exact percentiles, a latency histogram and counters per mode. The
+// reference shares no code with the evaluator: it does schoolbook arithmetic
+// on decimal strings.
+// Exits with 1 if any mode diverges from the reference.
+
+#define PRINT(X) std::cout << X
+#define ERRLOG(X) std::cerr << X
+#define __FLUSH() ; std::cout << std::endl
+
+namespace {
+    struct Options {
+        size_t count;
+        size_t operands;
+        size_t depth;
+        unsigned mix[4]; // relative weights of + - * /
+        unsigned invalidPercent;
+        long long maxOperand;
+        uint64_t seed;
+        size_t distinct; // expressions repeat, with fresh whitespace, past this many
+        size_t cacheCapacity;
+        bool json;
+    };
+
+    enum e_counter {
+        COUNTER_EXPRESSIONS,
+        COUNTER_TOKENS,
+        COUNTER_SKIPPED,
+        COUNTER_DIVERGENCES,
+        COUNTER_CACHE_HITS,
+        COUNTER_CACHE_MISSES,
+        COUNTER_CACHE_EVICTIONS,
+        COUNTER_COUNT
+    };
+
+    const char* _nsCounterNames[] = {
+        "expressions", "tokens", "skipped", "divergences", "cache_hits", "cache_misses", "cache_evictions"
+    };
+
+    enum e_outcome {
+        OUTCOME_OK,
+        OUTCOME_DIVISION_BY_ZERO,
+        OUTCOME_STACK_UNDERFLOW,
+        OUTCOME_INVALID_TOKEN,
+        OUTCOME_EXTRA_OPERANDS,
+        OUTCOME_OVERFLOW,
+        OUTCOME_UNKNOWN
+    };
+
+    const char* _nsOutcomeNames[] = {
+        "ok", "division by zero", "stack underflow", "invalid token",
+        "extra operands", "overflow", "unknown exception"
+    };
+
+    struct Outcome {
+        e_outcome kind;
+        std::string value;
+    };
+
+    struct Reference {
+        Outcome outcome;
+        bool intSafe; // every literal and intermediate fits in an int
+    };
+
+    struct Case {
+        std::string expr;
+        size_t tokens;
+        Reference ref;
+    };
+
+    std::string __toString(long long v) {
+        std::ostringstream oss;
+        oss << v;
+        return oss.str();
+    }
+
+    char __pickOperator(Options const& opt, Perf::Rng& rng) {
+        static const char ops[] = { '+', '-', '*', '/' };
+        unsigned total = opt.mix[0] + opt.mix[1] + opt.mix[2] + opt.mix[3];
+        uint64_t r = rng.below(total);
+        for (int i = 0; i < 4; ++i) {
+            if (r < opt.mix[i])
+                return ops[i];
+            r -= opt.mix[i];
+        }
+        return '+';
+    }
+
+    std::vector<std::string> __generateValid(Options const& opt, Perf::Rng& rng) {
+        std::vector<std::string> tokens;
+        size_t remaining = opt.operands;
+        size_t depth = 0;
+
+        while (remaining > 0 || depth > 1) {
+            bool push = remaining > 0
+                && (depth < 2 || (depth < opt.depth && rng.below(2) == 0));
+            if (push) {
+                long long v = static_cast<long long>(rng.below(opt.maxOperand + 1));
+                if (rng.below(8) == 0)
+                    v = -v;
+                tokens.push_back(__toString(v));
+                --remaining;
+                ++depth;
+            } else {
+                tokens.push_back(std::string(1, __pickOperator(opt, rng)));
+                --depth;
+            }
+        }
+        return tokens;
+    }
+
+    void __corrupt(std::vector<std::string>& tokens, Perf::Rng& rng) {
+        size_t at = rng.below(tokens.size() + 1);
+        switch (rng.below(4)) {
+        case 0: tokens.insert(tokens.begin() + at, rng.below(2) ? "x" : "1a"); break;
+        case 1: tokens.insert(tokens.begin() + at, "+"); break;   // likely underflow
+        case 2: tokens.insert(tokens.begin() + at, "7"); break;   // likely extra operand
+        default:
+            tokens.push_back("0");
+            tokens.push_back("/");
+        }
+    }
+
+    std::string __join(std::vector<std::string> const& tokens, Perf::Rng& rng) {
+        std::string out;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            if (i)
+                out.append(1 + rng.below(3), rng.below(8) ? ' ' : '\t');
+            out += tokens[i];
+        }
+        return out;
+    }
+
+    // Arbitrary-precision integer as a sign and decimal digits, most
+    // significant first, with no leading zeros ("0" for zero, never
+    // negative). Schoolbook arithmetic only: slow, but independent of
+    // RPN::BigInt, so the wide mode's arithmetic cannot agree with it by
+    // sharing a bug.
+    struct Decimal {
+        bool neg;
+        std::string mag;
+    };
+
+    int __compareMag(std::string const& a, std::string const& b) {
+        if (a.size() != b.size())
+            return a.size() < b.size() ? -1 : 1;
+        return a.compare(b) < 0 ? -1 : (a.compare(b) > 0 ? 1 : 0);
+    }
+
+    std::string __stripZeros(std::string const& mag) {
+        size_t first = mag.find_first_not_of('0');
+        return first == std::string::npos ? "0" : mag.substr(first);
+    }
+
+    std::string __addMag(std::string const& a, std::string const& b) {
+        std::string out;
+        int carry = 0;
+        for (size_t i = 0; i < a.size() || i < b.size() || carry; ++i) {
+            int d = carry;
+            if (i < a.size()) d += a[a.size() - 1 - i] - '0';
+            if (i < b.size()) d += b[b.size() - 1 - i] - '0';
+            out.push_back(static_cast<char>('0' + d % 10));
+            carry = d / 10;
+        }
+        std::reverse(out.begin(), out.end());
+        return __stripZeros(out);
+    }
+
+    // a - b for a >= b.
+    std::string __subMag(std::string const& a, std::string const& b) {
+        std::string out;
+        int borrow = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            int d = (a[a.size() - 1 - i] - '0') - borrow;
+            if (i < b.size())
+                d -= b[b.size() - 1 - i] - '0';
+            borrow = d < 0;
+            out.push_back(static_cast<char>('0' + d + 10 * borrow));
+        }
+        std::reverse(out.begin(), out.end());
+        return __stripZeros(out);
+    }
+
+    std::string __mulMag(std::string const& a, std::string const& b) {
+        std::vector<int> acc(a.size() + b.size(), 0);
+        for (size_t i = a.size(); i-- > 0;) {
+            for (size_t j = b.size(); j-- > 0;) {
+                size_t at = i + j + 1;
+                int d = acc[at] + (a[i] - '0') * (b[j] - '0');
+                acc[at] = d % 10;
+                acc[at - 1] += d / 10;
+            }
+        }
+        std::string out;
+        for (size_t i = 0; i < acc.size(); ++i)
+            out.push_back(static_cast<char>('0' + acc[i]));
+        return __stripZeros(out);
+    }
+
+    // Long division, one quotient digit at a time by repeated subtraction.
+    std::string __divMag(std::string const& a, std::string const& b) {
+        std::string quotient;
+        std::string rem = "0";
+        for (size_t i = 0; i < a.size(); ++i) {
+            rem = __stripZeros(rem + a[i]);
+            char digit = '0';
+            while (__compareMag(rem, b) >= 0) {
+                rem = __subMag(rem, b);
+                ++digit;
+            }
+            quotient.push_back(digit);
+        }
+        return __stripZeros(quotient);
+    }
+
+    Decimal __make(bool neg, std::string const& mag) {
+        Decimal d;
+        d.mag = mag;
+        d.neg = neg && mag != "0";
+        return d;
+    }
+
+    Decimal __add(Decimal const& a, Decimal const& b) {
+        if (a.neg == b.neg)
+            return __make(a.neg, __addMag(a.mag, b.mag));
+        if (__compareMag(a.mag, b.mag) >= 0)
+            return __make(a.neg, __subMag(a.mag, b.mag));
+        return __make(b.neg, __subMag(b.mag, a.mag));
+    }
+
+    Decimal __negate(Decimal const& a) {
+        return __make(!a.neg, a.mag);
+    }
+
+    // Truncates toward zero, like C++ integer division.
+    Decimal __divide(Decimal const& a, Decimal const& b) {
+        return __make(a.neg != b.neg, __divMag(a.mag, b.mag));
+    }
+
+    // An optional sign, then at least one digit.
+    bool __parseDecimal(std::string const& token, Decimal& out) {
+        size_t i = (token[0] == '+' || token[0] == '-') ? 1 : 0;
+        if (i == token.size() || token.find_first_not_of("0123456789", i) != std::string::npos)
+            return false;
+        out = __make(token[0] == '-', __stripZeros(token.substr(i)));
+        return true;
+    }
+
+    bool __fitsInt(Decimal const& d) {
+        return __compareMag(d.mag, d.neg ? "2147483648" : "2147483647") <= 0;
+    }
+
+    std::string __toString(Decimal const& d) {
+        return d.neg ? "-" + d.mag : d.mag;
+    }
+
+    // Deliberately naive: arbitrary precision everywhere, no fast path,
+    // tokens re-split by istringstream.
+    Reference __evaluateReference(std::string const& expr) {
+        Reference ref;
+        ref.intSafe = true;
+        ref.outcome.kind = OUTCOME_OK;
+
+        std::vector<Decimal> stack;
+        std::istringstream iss(expr);
+        std::string token;
+
+        while (iss >> token) {
+            Decimal r;
+            if (token == "+" || token == "-" || token == "*" || token == "/") {
+                if (stack.size() < 2) {
+                    ref.outcome.kind = OUTCOME_STACK_UNDERFLOW;
+                    return ref;
+                }
+                Decimal b = stack.back(); stack.pop_back();
+                Decimal a = stack.back(); stack.pop_back();
+                switch (token[0]) {
+                case '+': r = __add(a, b); break;
+                case '-': r = __add(a, __negate(b)); break;
+                case '*': r = __make(a.neg != b.neg, __mulMag(a.mag, b.mag)); break;
+                default:
+                    if (b.mag == "0") {
+                        ref.outcome.kind = OUTCOME_DIVISION_BY_ZERO;
+                        return ref;
+                    }
+                    r = __divide(a, b);
+                }
+            } else if (!__parseDecimal(token, r)) {
+                ref.outcome.kind = OUTCOME_INVALID_TOKEN;
+                return ref;
+            }
+
+            if (!__fitsInt(r))
+                ref.intSafe = false;
+            stack.push_back(r);
+        }
+
+        if (stack.empty())
+            ref.outcome.kind = OUTCOME_STACK_UNDERFLOW;
+        else if (stack.size() > 1)
+            ref.outcome.kind = OUTCOME_EXTRA_OPERANDS;
+        else
+            ref.outcome.value = __toString(stack.back());
+        return ref;
+    }
+
+    struct Mode {
+        const char* name;
+        RPN::ArithmeticMode arithmetic;
+        bool stream;
+        bool cached;
+    };
+
+    const Mode _nsModes[] = {
+        { "int/string",  RPN::INT_ARITHMETIC,  false, false },
+        { "int/stream",  RPN::INT_ARITHMETIC,  true,  false },
+        { "int/cached",  RPN::INT_ARITHMETIC,  false, true },
+        { "wide/string", RPN::WIDE_ARITHMETIC, false, false },
+        { "wide/stream", RPN::WIDE_ARITHMETIC, true,  false },
+        { "wide/cached", RPN::WIDE_ARITHMETIC, false, true },
+    };
+    const size_t _nsModeCount = sizeof(_nsModes) / sizeof(_nsModes[0]);
+
+    // `elapsed` covers evaluation and result extraction, not the formatting
+    // of the result for comparison.
+    Outcome __run(Mode const& mode, std::string const& expr, size_t bufferSize, uint64_t& elapsed) {
+        Outcome out;
+        out.kind = OUTCOME_OK;
+        uint64_t start = Perf::nowNs();
+        try {
+            if (mode.stream) {
+                std::istringstream in(expr);
+                RPN::processStream(in, bufferSize);
+            } else {
+                RPN::processExpression(expr);
+            }
+            if (mode.arithmetic == RPN::WIDE_ARITHMETIC) {
+                RPN::Number result = RPN::getWideResult();
+                elapsed = Perf::nowNs() - start;
+                out.value = result.toString();
+            } else {
+                int result = RPN::getResult();
+                elapsed = Perf::nowNs() - start;
+                out.value = __toString(result);
+            }
+            return out;
+        } catch (const RPN::DivisionByZeroError&) {
+            out.kind = OUTCOME_DIVISION_BY_ZERO;
+        } catch (const RPN::StackUnderflowError&) {
+            out.kind = OUTCOME_STACK_UNDERFLOW;
+        } catch (const RPN::InvalidTokenError&) {
+            out.kind = OUTCOME_INVALID_TOKEN;
+        } catch (const RPN::ExtraOperandsError&) {
+            out.kind = OUTCOME_EXTRA_OPERANDS;
+        } catch (const RPN::OverflowError&) {
+            out.kind = OUTCOME_OVERFLOW;
+        } catch (...) {
+            out.kind = OUTCOME_UNKNOWN;
+        }
+        elapsed = Perf::nowNs() - start;
+        return out;
+    }
+
+    bool __sameOutcome(Outcome const& a, Outcome const& b) {
+        return a.kind == b.kind && (a.kind != OUTCOME_OK || a.value == b.value);
+    }
+
+    void __usage() {
+        ERRLOG("Usage:\n");
+        ERRLOG("\tRPN_bench [--count N] [--operands N] [--depth N] [--mix A,S,M,D]\n");
+        ERRLOG("\t          [--invalid PERCENT] [--max-operand N] [--seed N]\n");
+        ERRLOG("\t          [--distinct N] [--cache ENTRIES] [--format text|json]") __FLUSH();
+    }
+
+    bool __parseOptions(int argc, char* argv[], Options& opt) {
+        opt.count = 10000;
+        opt.operands = 32;
+        opt.depth = 8;
+        opt.mix[0] = opt.mix[1] = opt.mix[2] = opt.mix[3] = 1;
+        opt.invalidPercent = 10;
+        opt.maxOperand = 9;
+        opt.seed = 42;
+        opt.distinct = 0;
+        opt.cacheCapacity = 1024;
+        opt.json = false;
+
+        for (int i = 1; i < argc; ++i) {
+            std::string flag = argv[i];
+            if (i + 1 >= argc)
+                return false;
+            const char* val = argv[++i];
+            char* end = NULL;
+
+            if (flag == "--format") {
+                if (std::string(val) != "text" && std::string(val) != "json")
+                    return false;
+                opt.json = std::string(val) == "json";
+                continue;
+            }
+            if (flag == "--mix") {
+                unsigned w[4];
+                if (std::sscanf(val, "%u,%u,%u,%u", &w[0], &w[1], &w[2], &w[3]) != 4
+                    || w[0] + w[1] + w[2] + w[3] == 0)
+                    return false;
+                std::memcpy(opt.mix, w, sizeof(w));
+                continue;
+            }
+
+            unsigned long long n = std::strtoull(val, &end, 10);
+            if (*val == '\0' || *end != '\0')
+                return false;
+            if (flag == "--count") opt.count = n;
+            else if (flag == "--operands") opt.operands = n ? n : 1;
+            else if (flag == "--depth") opt.depth = n < 2 ? 2 : n;
+            else if (flag == "--invalid") opt.invalidPercent = n > 100 ? 100 : n;
+            else if (flag == "--max-operand") opt.maxOperand = n > INT_MAX ? INT_MAX : n;
+            else if (flag == "--seed") opt.seed = n;
+            else if (flag == "--distinct") opt.distinct = n;
+            else if (flag == "--cache") opt.cacheCapacity = n ? n : 1;
+            else return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!__parseOptions(argc, argv, opt)) {
+        __usage();
+        return 2;
+    }
+
+    Perf::Rng rng(opt.seed);
+    std::vector<Case> corpus(opt.count);
+    size_t totalTokens = 0;
+    size_t distinct = (opt.distinct && opt.distinct < opt.count) ? opt.distinct : opt.count;
+    std::vector<std::vector<std::string> > shapes(distinct);
+    std::vector<Reference> shapeRefs(distinct);
+
+    for (size_t i = 0; i < distinct; ++i) {
+        shapes[i] = __generateValid(opt, rng);
+        if (rng.below(100) < opt.invalidPercent)
+            __corrupt(shapes[i], rng);
+        shapeRefs[i] = __evaluateReference(__join(shapes[i], rng));
+    }
+    for (size_t i = 0; i < opt.count; ++i) {
+        size_t shape = i < distinct ? i : rng.below(distinct);
+        corpus[i].expr = __join(shapes[shape], rng);
+        corpus[i].tokens = shapes[shape].size();
+        corpus[i].ref = shapeRefs[shape];
+        totalTokens += corpus[i].tokens;
+    }
+
+    Perf::JsonWriter json(std::cout);
+    if (opt.json) {
+        Perf::beginReport(json, "RPN_bench");
+    } else {
+        PRINT("expressions: " << opt.count << " (" << distinct << " distinct), tokens: "
+              << totalTokens << ", seed: " << opt.seed) __FLUSH();
+        PRINT("mode           skipped   expr/s        tokens/s      p50(ns)   p90(ns)   p99(ns)   max(ns)") __FLUSH();
+    }
+
+    size_t divergences = 0;
+    for (size_t m = 0; m < _nsModeCount; ++m) {
+        Mode const& mode = _nsModes[m];
+        Perf::Samples latency;
+        Perf::Counters counters(_nsCounterNames, COUNTER_COUNT);
+        uint64_t totalNs = 0;
+        size_t tokens = 0;
+        size_t skipped = 0;
+
+        RPN::setArithmeticMode(mode.arithmetic);
+        RPN::setCacheCapacity(mode.cached ? opt.cacheCapacity : 0);
+        for (size_t i = 0; i < corpus.size(); ++i) {
+            Case const& c = corpus[i];
+            // int mode has undefined behaviour on overflow: only feed it
+            // expressions the reference proved to stay in range.
+            if (mode.arithmetic == RPN::INT_ARITHMETIC && !c.ref.intSafe) {
+                ++skipped;
+                continue;
+            }
+
+            size_t bufferSize = 1 + (i % 64);
+            uint64_t elapsed;
+            Outcome got = __run(mode, c.expr, bufferSize, elapsed);
+
+            latency.record(elapsed);
+            totalNs += elapsed;
+            tokens += c.tokens;
+
+            if (!__sameOutcome(got, c.ref.outcome)) {
+                counters.add(COUNTER_DIVERGENCES);
+                if (divergences < 10) {
+                    ERRLOG("DIVERGENCE [" << mode.name << "] `" << c.expr << "`: got "
+                           << _nsOutcomeNames[got.kind] << " " << got.value << ", expected "
+                           << _nsOutcomeNames[c.ref.outcome.kind] << " " << c.ref.outcome.value)
+                           << std::endl;
+                }
+                ++divergences;
+            }
+        }
+
+        double seconds = totalNs / 1e9;
+        double exprPerSec = seconds > 0 ? latency.count() / seconds : 0;
+        double tokPerSec = seconds > 0 ? tokens / seconds : 0;
+
+        if (opt.json) {
+            counters.add(COUNTER_EXPRESSIONS, latency.count());
+            counters.add(COUNTER_TOKENS, tokens);
+            counters.add(COUNTER_SKIPPED, skipped);
+            if (mode.cached) {
+                RPN::CacheStats stats = RPN::getCacheStats();
+                counters.add(COUNTER_CACHE_HITS, stats.hits);
+                counters.add(COUNTER_CACHE_MISSES, stats.misses);
+                counters.add(COUNTER_CACHE_EVICTIONS, stats.evictions);
+            }
+            json.beginObject();
+            json.field("mode", mode.name);
+            json.field("seed", opt.seed);
+            json.field("total_ns", totalNs);
+            json.field("expr_per_s", exprPerSec);
+            json.field("tokens_per_s", tokPerSec);
+            json.field("latency", latency);
+            json.field("counters", counters);
+            json.endObject();
+            continue;
+        }
+
+        std::cout.setf(std::ios::left, std::ios::adjustfield);
+        std::cout.width(15); PRINT(mode.name);
+        std::cout.width(10); PRINT(skipped);
+        std::cout.width(14); PRINT(static_cast<uint64_t>(exprPerSec));
+        std::cout.width(14); PRINT(static_cast<uint64_t>(tokPerSec));
+        std::cout.width(10); PRINT(latency.percentile(0.50));
+        std::cout.width(10); PRINT(latency.percentile(0.90));
+        std::cout.width(10); PRINT(latency.percentile(0.99));
+        PRINT(latency.max()) __FLUSH();
+
+        if (mode.cached) {
+            RPN::CacheStats stats = RPN::getCacheStats();
+            PRINT("  cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                  << stats.evictions << " evictions, " << stats.entries << "/"
+                  << stats.capacity << " entries") __FLUSH();
+        }
+    }
+    RPN::setArithmeticMode(RPN::INT_ARITHMETIC);
+    RPN::setCacheCapacity(0);
+    if (opt.json)
+        Perf::endReport(json);
+
+    if (divergences) {
+        ERRLOG(divergences << " divergence(s) from the reference evaluator") << std::endl;
+        return 1;
+    }
+    if (!opt.json) {
+        PRINT("No divergence from the reference evaluator.") __FLUSH();
+    }
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include "RPN.hpp"
 #include <cassert>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 
 void __myAssert(bool aExpr_) {
     if (!aExpr_)
@@ -98,6 +100,127 @@ void test_edge_cases() {
     std::cout << "Edge cases passed!\n";
 }
 
+void assertWideExpression(const std::string& expr, const std::string& expected) {
+    RPN::processExpression(expr);
+    __myAssert(RPN::getWideResult().toString() == expected);
+}
+
+void test_wide_arithmetic() {
+    std::cout << "Testing wide arithmetic...\n";
+
+    RPN::setArithmeticMode(RPN::WIDE_ARITHMETIC);
+
+    // Stays on the 64-bit fast path
+    assertWideExpression("3 4 + 5 *", "35");
+    assertWideExpression("2147483647 1 +", "2147483648");
+    assertWideExpression("-7 2 /", "-3");
+
+    // Promotes to 128 bits, then to arbitrary precision
+    assertWideExpression("9223372036854775807 1 +", "9223372036854775808");
+    assertWideExpression("4294967296 4294967296 * 4294967296 *", "79228162514264337593543950336");
+    assertWideExpression("18446744073709551616 18446744073709551616 * 18446744073709551616 *",
+                         "6277101735386680763835789423207666416102355444464034512896");
+
+    // Demotes again once the value fits
+    assertWideExpression("340282366920938463463374607431768211456 340282366920938463463374607431768211455 -", "1");
+    assertWideExpression("-9223372036854775808 -1 /", "9223372036854775808");
+    assertWideExpression("6277101735386680763835789423207666416102355444464034512896 79228162514264337593543950336 /",
+                         "79228162514264337593543950336");
+
+    RPN::processExpression("2147483647 1 +");
+    try {
+        RPN::getResult();
+        __myAssert(false && "Should have thrown OverflowError");
+    } catch (const RPN::OverflowError&) {
+        std::cout << "Overflow caught correctly\n";
+    }
+
+    try {
+        RPN::processExpression("99999999999999999999999 0 /");
+        __myAssert(false && "Should have thrown DivisionByZeroError");
+    } catch (const RPN::DivisionByZeroError&) {
+        std::cout << "Wide division by zero caught correctly\n";
+    }
+
+    RPN::setArithmeticMode(RPN::INT_ARITHMETIC);
+
+    std::cout << "Wide arithmetic passed!\n";
+}
+
+void test_streaming() {
+    std::cout << "Testing streaming evaluation...\n";
+
+    // Tiny buffers split tokens at every possible position
+    for (size_t bufferSize = 1; bufferSize <= 8; ++bufferSize) {
+        std::istringstream in("  12 34 +\n5 *   100 -  ");
+        RPN::processStream(in, bufferSize);
+        __myAssert(RPN::getResult() == 130);
+    }
+
+    RPN::setArithmeticMode(RPN::WIDE_ARITHMETIC);
+    std::istringstream wide("123456789012345678901234567890 2 *");
+    RPN::processStream(wide, 4);
+    __myAssert(RPN::getWideResult().toString() == "246913578024691357802469135780");
+    RPN::setArithmeticMode(RPN::INT_ARITHMETIC);
+
+    // A long generated expression: 1 1 + 1 + ... never held in one string
+    std::stringstream longExpr;
+    longExpr << "1";
+    for (int i = 0; i < 100000; ++i)
+        longExpr << " 1 +";
+    RPN::processStream(longExpr, 7);
+    __myAssert(RPN::getResult() == 100001);
+
+    try {
+        std::istringstream in("5 4 x");
+        RPN::processStream(in, 2);
+        __myAssert(false && "Should have thrown InvalidTokenError");
+    } catch (const RPN::InvalidTokenError&) {
+        std::cout << "Invalid streamed token caught correctly\n";
+    }
+
+    std::cout << "Streaming evaluation passed!\n";
+}
+
+void test_result_cache() {
+    std::cout << "Testing result cache...\n";
+
+    RPN::setCacheCapacity(2);
+
+    assertExpression("3 4 +", 7);
+    assertExpression("   3    4\t+ ", 7); // same tokens, same entry
+    __myAssert(RPN::getCacheStats().hits == 1);
+    __myAssert(RPN::getCacheStats().misses == 1);
+
+    // Errors are replayed as the exception they raised
+    for (int i = 0; i < 2; ++i) {
+        try {
+            RPN::processExpression("5 0 /");
+            __myAssert(false && "Should have thrown DivisionByZeroError");
+        } catch (const RPN::DivisionByZeroError&) {}
+    }
+    for (int i = 0; i < 2; ++i) {
+        try {
+            RPN::processExpression("5 4 3 +");
+            RPN::getResult();
+            __myAssert(false && "Should have thrown ExtraOperandsError");
+        } catch (const RPN::ExtraOperandsError&) {}
+    }
+    __myAssert(RPN::getCacheStats().hits == 3);
+
+    // The arithmetic mode is part of the key
+    RPN::setArithmeticMode(RPN::WIDE_ARITHMETIC);
+    assertWideExpression("3 4 +", "7");
+    RPN::setArithmeticMode(RPN::INT_ARITHMETIC);
+
+    RPN::CacheStats stats = RPN::getCacheStats();
+    __myAssert(stats.entries == 2 && stats.capacity == 2);
+    __myAssert(stats.evictions == 2);
+
+    RPN::setCacheCapacity(0);
+    std::cout << "Result cache passed!\n";
+}
+
 #define PRINT(X) std::cout << X
 #define ERRLOG(X) std::cerr << X
 #define __FLUSH() ; std::cout << std::endl
@@ -110,17 +233,44 @@ int main(int argc, char *argv[]) {
         test_complex_expressions();
         test_error_handling();
         test_edge_cases();
+        test_wide_arithmetic();
+        test_streaming();
+        test_result_cache();
         
         PRINT("\nAll tests passed successfully!") __FLUSH();
 #else
-        if (argc != 2) {
+        int arg = 1;
+        bool wide = (arg < argc && std::string(argv[arg]) == "--wide");
+        if (wide) {
+            RPN::setArithmeticMode(RPN::WIDE_ARITHMETIC);
+            ++arg;
+        }
+
+        std::string source = arg < argc ? argv[arg] : "";
+        if (source == "--stdin" && arg + 1 == argc) {
+            RPN::processStream(std::cin);
+        } else if (source == "--file" && arg + 2 == argc) {
+            std::ifstream file(argv[arg + 1], std::ios::in | std::ios::binary);
+            if (!file.is_open()) {
+                ERRLOG("Error: could not open " << argv[arg + 1]) __FLUSH();
+                return 1;
+            }
+            RPN::processStream(file);
+        } else if (arg + 1 == argc) {
+            RPN::processExpression(argv[arg]);
+        } else {
             ERRLOG("Usage:\n");
-            ERRLOG("\tRPN <expression-string>") __FLUSH();
+            ERRLOG("\tRPN [--wide] <expression-string>\n");
+            ERRLOG("\tRPN [--wide] --stdin\n");
+            ERRLOG("\tRPN [--wide] --file <path>") __FLUSH();
             return 2;
         }
 
-        RPN::processExpression(argv[1]);
-        PRINT(RPN::getResult()); __FLUSH();
+        if (wide) {
+            PRINT(RPN::getWideResult()); __FLUSH();
+        } else {
+            PRINT(RPN::getResult()); __FLUSH();
+        }
 #endif
         return 0;
     } catch (const std::exception& e) {
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <iterator>
+
+namespace PmergeMe {
+    // Sequence stored as a run of small contiguous blocks. An insert only
+    // shifts the tail of one block (at most 2 * BLOCK elements), not the tail
+    // of the whole sequence; a Fenwick tree over block sizes finds the block
+    // holding a position in O(log(n / BLOCK)). A block that reaches twice
+    // BLOCK elements is split in two, rebuilding the tree. clear() keeps the
+    // blocks for reuse, so refilling a cleared chain allocates nothing.
+    template <typename T>
+    class BlockedVector {
+    private:
+        typedef std::vector<T> Block;
+
+        enum { BLOCK = 512 };
+
+    public:
+        class const_iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef T value_type;
+            typedef ptrdiff_t difference_type;
+            typedef T const *pointer;
+            typedef T const &reference;
+
+            const_iterator() : _blocks(NULL), _block(0), _offset(0) {}
+            T const &operator*() const { return (*(*_blocks)[_block])[_offset]; }
+            T const *operator->() const { return &**this; }
+            const_iterator &operator++() {
+                if (++_offset == (*_blocks)[_block]->size()) {
+                    ++_block;
+                    _offset = 0;
+                }
+                return *this;
+            }
+            bool operator==(const_iterator const &rhs) const { return _block == rhs._block && _offset == rhs._offset; }
+            bool operator!=(const_iterator const &rhs) const { return !(*this == rhs); }
+        private:
+            friend class BlockedVector;
+            const_iterator(const std::vector<Block *> *blocks, size_t block)
+                : _blocks(blocks), _block(block), _offset(0) {}
+            const std::vector<Block *> *_blocks;
+            size_t _block;
+            size_t _offset;
+        };
+
+        BlockedVector() : _blocks(), _spare(), _tree(1, 0), _top(0), _size(0), _allocations(0) {}
+
+        ~BlockedVector() {
+            clear();
+            for (size_t b = 0; b < _spare.size(); ++b)
+                delete _spare[b];
+        }
+
+        size_t size(void) const { return _size; }
+        bool empty(void) const { return _size == 0; }
+        // Blocks allocated so far; reused spares are not counted.
+        size_t allocations(void) const { return _allocations; }
+
+        const_iterator begin(void) const { return const_iterator(&_blocks, 0); }
+        const_iterator end(void) const { return const_iterator(&_blocks, _blocks.size()); }
+
+        T const &at(size_t index) const {
+            size_t offset;
+            size_t b = locate_impl(index, offset);
+            return (*_blocks[b])[offset];
+        }
+
+        // Inserts before the element at `index`; index == size() appends.
+        void insert(size_t index, T const &value) {
+            size_t b;
+            size_t offset;
+
+            if (_blocks.empty()) {
+                _blocks.push_back(newBlock_impl());
+                rebuild_impl();
+            }
+            if (index == _size) {
+                b = _blocks.size() - 1;
+                offset = _blocks[b]->size();
+            } else {
+                b = locate_impl(index, offset);
+            }
+
+            Block &block = *_blocks[b];
+            block.insert(block.begin() + offset, value);
+            ++_size;
+            if (block.size() >= 2 * BLOCK) {
+                split_impl(b);
+            } else {
+                for (size_t i = b + 1; i < _tree.size(); i += i & (~i + 1))
+                    _tree[i] += 1;
+            }
+        }
+
+        void push_back(T const &value) {
+            insert(_size, value);
+        }
+
+        void clear(void) {
+            for (size_t b = 0; b < _blocks.size(); ++b) {
+                _blocks[b]->clear();
+                _spare.push_back(_blocks[b]);
+            }
+            _blocks.clear();
+            _size = 0;
+            rebuild_impl();
+        }
+
+        // Copies the elements, in order, into contiguous storage.
+        void flatten(std::vector<T> &out) const {
+            out.clear();
+            out.reserve(_size);
+            for (size_t b = 0; b < _blocks.size(); ++b)
+                out.insert(out.end(), _blocks[b]->begin(), _blocks[b]->end());
+        }
+
+    private:
+        std::vector<Block *> _blocks; // pointers, so a split moves no elements
+        std::vector<Block *> _spare;  // emptied blocks, kept by clear()
+        std::vector<size_t> _tree;    // Fenwick tree of block sizes, 1-based
+        size_t _top;                  // highest power of two below _tree.size()
+        size_t _size;
+        size_t _allocations;
+
+        // Block holding element `index`, and the element's offset within it.
+        size_t locate_impl(size_t index, size_t &offset) const {
+            size_t idx = 0;
+            size_t rem = index;
+            for (size_t step = _top; step > 0; step >>= 1) {
+                if (idx + step < _tree.size() && _tree[idx + step] <= rem) {
+                    idx += step;
+                    rem -= _tree[idx];
+                }
+            }
+            offset = rem;
+            return idx;
+        }
+
+        Block *newBlock_impl(void) {
+            if (!_spare.empty()) {
+                Block *block = _spare.back();
+                _spare.pop_back();
+                return block;
+            }
+            Block *block = new Block();
+            block->reserve(2 * BLOCK);
+            ++_allocations;
+            return block;
+        }
+
+        void split_impl(size_t b) {
+            Block &full = *_blocks[b];
+            Block *half = newBlock_impl();
+
+            half->assign(full.begin() + full.size() / 2, full.end());
+            full.erase(full.begin() + full.size() / 2, full.end());
+            _blocks.insert(_blocks.begin() + b + 1, half);
+            rebuild_impl();
+        }
+
+        // O(number of blocks) bottom-up construction.
+        void rebuild_impl(void) {
+            _tree.assign(_blocks.size() + 1, 0);
+            for (size_t i = 1; i < _tree.size(); ++i) {
+                _tree[i] += _blocks[i - 1]->size();
+                size_t parent = i + (i & (~i + 1));
+                if (parent < _tree.size())
+                    _tree[parent] += _tree[i];
+            }
+            _top = 1;
+            while (_top * 2 < _tree.size())
+                _top *= 2;
+        }
+
+        BlockedVector(const BlockedVector &other);
+        BlockedVector &operator=(const BlockedVector &rhs);
+    };
+}
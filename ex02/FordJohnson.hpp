@@ -0,0 +1,847 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <iterator>
+#include <functional>
+#include <algorithm>
+#include <list>
+#include "BlockedVector.hpp"
+#include "IndexedSkipList.hpp"
+#include "ThreadPool.hpp"
+#include "FordJohnsonProfile.hpp"
+#include "Perf.hpp"
+
+namespace PmergeMe {
+    // Comparison-counting policies for the engine. The engine calls tick()
+    // once per comparison, or add() with a batch's total; NoComparisonCount's
+    // are empty and inline away.
+    struct NoComparisonCount {
+        NoComparisonCount() {}
+        explicit NoComparisonCount(size_t &) {}
+        void tick(void) const {}
+        void add(size_t) const {}
+    };
+
+    class ComparisonCount {
+    public:
+        explicit ComparisonCount(size_t &counter) : _counter(&counter) {}
+        void tick(void) const { ++*_counter; }
+        void add(size_t n) const { *_counter += n; }
+    private:
+        size_t *_counter;
+    };
+
+    // Tracks where the sorted winners a_0..a_{m-1} sit in the main chain while
+    // losers are inserted, so a loser's bound (its partner's position) is known
+    // without searching. Fenwick tree over g: the weight of g is a_g itself plus
+    // the elements inserted between a_{g-1} and a_g, so the prefix sum up to k
+    // is one past the position of a_k.
+    class ChainPositions {
+    public:
+        explicit ChainPositions(size_t winners) : _tree(), _top(1) {
+            reset(winners);
+        }
+
+        // Starts over for a chain of `winners` winners, keeping the storage.
+        void reset(size_t winners) {
+            _tree.assign(winners + 1, 0);
+            _top = 1;
+            for (size_t i = 1; i <= winners; ++i) {
+                _tree[i] += 1;
+                size_t parent = i + (i & (~i + 1));
+                if (parent <= winners)
+                    _tree[parent] += _tree[i];
+            }
+            while (_top * 2 <= winners)
+                _top *= 2;
+            if (winners)
+                __add(0, 1); // b_0 is already in front of a_0
+        }
+
+        size_t positionOf(size_t k) const {
+            size_t sum = 0;
+            for (size_t i = k + 1; i > 0; i -= i & (~i + 1))
+                sum += _tree[i];
+            return sum - 1;
+        }
+
+        // An element was inserted at main-chain position `pos`.
+        void inserted(size_t pos) {
+            size_t idx = 0;
+            size_t rem = pos;
+            for (size_t step = _top; step > 0; step >>= 1) {
+                if (idx + step < _tree.size() && _tree[idx + step] <= rem) {
+                    idx += step;
+                    rem -= _tree[idx];
+                }
+            }
+            if (idx + 1 < _tree.size()) // otherwise it went after the last winner
+                __add(idx, 1);
+        }
+
+    private:
+        std::vector<size_t> _tree;
+        size_t _top;
+
+        void __add(size_t g, size_t delta) {
+            for (size_t i = g + 1; i < _tree.size(); i += i & (~i + 1))
+                _tree[i] += delta;
+        }
+    };
+
+    // Scratch shared by every level of one sort, sized once up front. The
+    // arena holds each level's winners (n/2 + n/4 + ... < n indices in all)
+    // and pairOf maps an element to its pair, so the recursion carves all of
+    // its index storage out of about 2n entries. The main chain, the partner
+    // positions and the batch buffers are reused level after level: a level
+    // only builds its chain once the levels below it are done.
+    template <typename Chain>
+    struct FordJohnsonWorkspace {
+        std::vector<size_t> arena;
+        std::vector<size_t> pairOf;
+        Chain chain;
+        ChainPositions positions;
+        std::vector<size_t> batchItems;
+        std::vector<size_t> batchBounds;
+        std::vector<size_t> batchGaps;
+        std::vector<size_t> batchOrder;
+        std::vector<size_t> runStarts; // stable sorts: where each run of equal elements starts
+        std::vector<size_t> runOrder;
+        FordJohnsonProfile *profile; // NULL, or where _PMM_PROFILE builds record
+
+        explicit FordJohnsonWorkspace(size_t n = 0)
+            : arena(n), pairOf(n), chain(), positions(0),
+              batchItems(), batchBounds(), batchGaps(), batchOrder(), runStarts(), runOrder(), profile(NULL) {}
+
+        // Makes room for a sort of n elements. Storage only grows, so one
+        // workspace can serve any number of sorts, one at a time.
+        void prepare(size_t n) {
+            if (arena.size() < n) {
+                arena.resize(n);
+                pairOf.resize(n);
+            }
+        }
+    };
+
+#if defined(_PMM_PROFILE)
+    // Passes comparisons on to the caller's counter and to the profile.
+    template <typename Counter>
+    class ProfiledCount {
+    public:
+        ProfiledCount(Counter count, FordJohnsonProfile &profile) : _count(count), _profile(&profile) {}
+        void tick(void) const { _count.tick(); _profile->compared(1); }
+        void add(size_t n) const { _count.add(n); _profile->compared(n); }
+    private:
+        Counter _count;
+        FordJohnsonProfile *_profile;
+    };
+
+    // Records one level of one sort into the workspace's profile, if it has
+    // one: each start() closes the running phase and opens the next, which
+    // is charged the time, comparisons and allocations until it is closed.
+    template <typename Chain>
+    class FordJohnsonLevelProfiler {
+    public:
+        FordJohnsonLevelProfiler(FordJohnsonWorkspace<Chain>& ws, size_t elements)
+            : _ws(ws), _depth(ws.profile ? ws.profile->enterLevel(elements) : 0), _phase(FJ_PHASE_COUNT),
+              _startNs(0), _comparisons(0), _chainAllocations(0) {}
+
+        ~FordJohnsonLevelProfiler() {
+            stop();
+            if (_ws.profile)
+                _ws.profile->leaveLevel();
+        }
+
+        void start(e_fj_phase phase, size_t elements) {
+            if (!_ws.profile)
+                return;
+            stop();
+            _phase = phase;
+            current_impl().elements += elements;
+            _comparisons = _ws.profile->comparisons();
+            snapshot_impl();
+            _startNs = Perf::nowNs();
+        }
+
+        void moved(size_t n) {
+            if (_phase != FJ_PHASE_COUNT)
+                current_impl().moves += n;
+        }
+
+        void stop(void) {
+            if (_phase == FJ_PHASE_COUNT)
+                return;
+            FordJohnsonPhaseStats& stats = current_impl();
+            stats.elapsedNs += Perf::nowNs() - _startNs;
+            stats.comparisons += _ws.profile->comparisons() - _comparisons;
+            stats.allocations += growths_impl();
+            _phase = FJ_PHASE_COUNT;
+        }
+
+    private:
+        FordJohnsonWorkspace<Chain>& _ws;
+        size_t _depth;
+        e_fj_phase _phase; // FJ_PHASE_COUNT: none running
+        uint64_t _startNs;
+        size_t _comparisons;
+        size_t _chainAllocations;
+        size_t _capacities[4];
+
+        // By depth each time: deeper levels may grow the profile's table.
+        FordJohnsonPhaseStats& current_impl(void) {
+            return _ws.profile->level(_depth).phases[_phase];
+        }
+
+        // Chain allocations plus buffers whose capacity changed since the
+        // snapshot; the batch reserves its buffers, so each grows at most
+        // once a batch.
+        size_t growths_impl(void) const {
+            size_t growths = _ws.chain.allocations() - _chainAllocations;
+            for (int b = 0; b < 4; ++b)
+                growths += buffer_impl(b).capacity() != _capacities[b];
+            return growths;
+        }
+
+        void snapshot_impl(void) {
+            _chainAllocations = _ws.chain.allocations();
+            for (int b = 0; b < 4; ++b)
+                _capacities[b] = buffer_impl(b).capacity();
+        }
+
+        std::vector<size_t> const& buffer_impl(int b) const {
+            std::vector<size_t> const *buffers[] = { &_ws.batchItems, &_ws.batchBounds, &_ws.batchGaps, &_ws.batchOrder };
+            return *buffers[b];
+        }
+
+        FordJohnsonLevelProfiler(const FordJohnsonLevelProfiler& other);
+        FordJohnsonLevelProfiler& operator=(const FordJohnsonLevelProfiler& rhs);
+    };
+
+#   define __PMM_PROFILE_LEVEL(ws, n) FordJohnsonLevelProfiler<Chain> __profiler(ws, n)
+#   define __PMM_PROFILE_PHASE(phase, elements) __profiler.start(phase, elements)
+#   define __PMM_PROFILE_MOVED(n) __profiler.moved(n)
+#   define __PMM_PROFILE_STOP() __profiler.stop()
+#else
+#   define __PMM_PROFILE_LEVEL(ws, n) ((void)0)
+#   define __PMM_PROFILE_PHASE(phase, elements) ((void)0)
+#   define __PMM_PROFILE_MOVED(n) ((void)0)
+#   define __PMM_PROFILE_STOP() ((void)0)
+#endif
+
+    // Binary search in range [0, high) of the main chain for element `item`.
+    template <typename RandomIt, typename Compare, typename Counter, typename Chain>
+    size_t __fordJohnsonSearch(RandomIt first, const Chain& chain, size_t item, size_t high,
+                               Compare& comp, Counter& count) {
+        size_t l = 0, h = high;
+        while (l < h) {
+            size_t mid = (l + h) / 2;
+            if (comp(first[chain.at(mid)], first[item]))
+                l = mid + 1;
+            else
+                h = mid;
+            count.tick();
+        }
+        return l;
+    }
+
+    // Parallel mode thresholds: smaller levels and groups are not worth a
+    // round trip through the pool. Levels of up to FJ_SMALL_MAX elements go
+    // to the unrolled base case instead of the chain.
+    enum {
+        FJ_PARALLEL_MIN_PAIRS = 1 << 14,
+        FJ_PARALLEL_MIN_BATCH = 1 << 10,
+        FJ_SMALL_MAX = 16
+    };
+
+    // Orders each pair in place, loser first, and records the winner of
+    // pair i in winners[i].
+    template <typename RandomIt, typename Compare>
+    void __fordJohnsonPairUp(RandomIt first, size_t *items, size_t *winners,
+                             Compare& comp, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!comp(first[items[2 * i]], first[items[2 * i + 1]])) {
+                size_t tmp = items[2 * i];
+                items[2 * i] = items[2 * i + 1];
+                items[2 * i + 1] = tmp;
+            }
+            winners[i] = items[2 * i + 1];
+        }
+    }
+
+    template <typename RandomIt, typename Compare>
+    struct PairingTask {
+        RandomIt first;
+        size_t *items;
+        size_t *winners;
+        Compare *comp;
+
+        static void run(void *ctx, size_t begin, size_t end) {
+            PairingTask *t = static_cast<PairingTask *>(ctx);
+            __fordJohnsonPairUp(t->first, t->items, t->winners, *t->comp, begin, end);
+        }
+    };
+
+    // Jacobsthal group bounds t_k = t_{k-1} + 2 t_{k-2}: 1, 3, 5, 11, 21, ...
+    template <int K>
+    struct JacobsthalBound {
+        enum { value = JacobsthalBound<K - 1>::value + 2 * JacobsthalBound<K - 2>::value };
+    };
+
+    template <>
+    struct JacobsthalBound<0> {
+        enum { value = 1 };
+    };
+
+    template <>
+    struct JacobsthalBound<1> {
+        enum { value = 3 };
+    };
+
+    // Inserts pend elements (t_{K-1}, t_K] of a small level, then the later
+    // groups; the recursion stops at compile time once every one of the
+    // `Pending` elements is placed. partnerPos[k] is where winner k sits in
+    // the chain.
+    template <size_t Pending, int K,
+              bool Done = (static_cast<size_t>(JacobsthalBound<K - 1>::value) >= Pending)>
+    struct SmallJacobsthalGroups {
+        template <typename RandomIt, typename Compare, typename Counter>
+        static void insert(RandomIt first, size_t *chain, size_t size, size_t *partnerPos,
+                           const size_t *pend, size_t pairCount, Compare& comp, Counter& count) {
+            const size_t lo = static_cast<size_t>(JacobsthalBound<K - 1>::value) + 1;
+            const size_t bound = static_cast<size_t>(JacobsthalBound<K>::value);
+            const size_t hi = bound < Pending ? bound : Pending;
+
+            for (size_t j = hi; j >= lo; --j) {
+                size_t idx = j - 1;
+                size_t loser = pend[idx];
+                size_t l = 0, h = idx < pairCount ? partnerPos[idx] : size;
+                while (l < h) {
+                    size_t mid = (l + h) / 2;
+                    if (comp(first[chain[mid]], first[loser]))
+                        l = mid + 1;
+                    else
+                        h = mid;
+                    count.tick();
+                }
+                for (size_t q = size; q > l; --q)
+                    chain[q] = chain[q - 1];
+                chain[l] = loser;
+                ++size;
+                for (size_t k = 0; k < pairCount; ++k)
+                    partnerPos[k] += partnerPos[k] >= l;
+            }
+            SmallJacobsthalGroups<Pending, K + 1>::insert(first, chain, size, partnerPos, pend, pairCount, comp, count);
+        }
+    };
+
+    template <size_t Pending, int K>
+    struct SmallJacobsthalGroups<Pending, K, true> {
+        template <typename RandomIt, typename Compare, typename Counter>
+        static void insert(RandomIt, size_t *, size_t, size_t *, const size_t *, size_t, Compare&, Counter&) {}
+    };
+
+    // Merge-insertion of exactly N elements, unrolled at compile time down
+    // to the single element: the same pairing, binary searches and
+    // Jacobsthal order as __fordJohnsonLevel, hence the same comparisons,
+    // but over arrays on the stack, with the partner positions kept in a
+    // plain array, instead of the workspace's chain and Fenwick tree. Up to
+    // 16 elements, merge-insertion's worst case matches the best decision
+    // trees known, and sorting networks take more comparisons (60 at 16).
+    template <size_t N>
+    struct SmallMergeInsertion {
+        template <typename RandomIt, typename Compare, typename Counter>
+        static void sort(RandomIt first, size_t *items, size_t *pairOf, Compare& comp, Counter& count) {
+            const size_t pairCount = N / 2;
+            size_t winners[N / 2];
+            size_t pend[N / 2 + 1];
+            size_t partnerPos[N / 2];
+            size_t chain[N];
+
+            __fordJohnsonPairUp(first, items, winners, comp, 0, pairCount);
+            count.add(pairCount);
+            SmallMergeInsertion<N / 2>::sort(first, winners, pairOf, comp, count);
+
+            for (size_t i = 0; i < pairCount; ++i)
+                pairOf[items[2 * i + 1]] = i;
+            for (size_t k = 0; k < pairCount; ++k) {
+                pend[k] = items[2 * pairOf[winners[k]]];
+                chain[k + 1] = winners[k];
+                partnerPos[k] = k + 1;
+            }
+            pend[pairCount] = items[N - 1]; // the odd element out, when N is odd
+            chain[0] = pend[0];
+
+            SmallJacobsthalGroups<N / 2 + N % 2, 1>::insert(first, chain, pairCount + 1, partnerPos, pend,
+                                                            pairCount, comp, count);
+            for (size_t i = 0; i < N; ++i)
+                items[i] = chain[i];
+        }
+    };
+
+    template <>
+    struct SmallMergeInsertion<1> {
+        template <typename RandomIt, typename Compare, typename Counter>
+        static void sort(RandomIt, size_t *, size_t *, Compare&, Counter&) {}
+    };
+
+    // Sorts a level of 2 to FJ_SMALL_MAX elements with its unrolled base case.
+    template <typename RandomIt, typename Compare, typename Counter>
+    void __fordJohnsonSmall(RandomIt first, size_t *items, size_t n, size_t *pairOf,
+                            Compare& comp, Counter& count) {
+        switch (n) {
+            case 2: SmallMergeInsertion<2>::sort(first, items, pairOf, comp, count); break;
+            case 3: SmallMergeInsertion<3>::sort(first, items, pairOf, comp, count); break;
+            case 4: SmallMergeInsertion<4>::sort(first, items, pairOf, comp, count); break;
+            case 5: SmallMergeInsertion<5>::sort(first, items, pairOf, comp, count); break;
+            case 6: SmallMergeInsertion<6>::sort(first, items, pairOf, comp, count); break;
+            case 7: SmallMergeInsertion<7>::sort(first, items, pairOf, comp, count); break;
+            case 8: SmallMergeInsertion<8>::sort(first, items, pairOf, comp, count); break;
+            case 9: SmallMergeInsertion<9>::sort(first, items, pairOf, comp, count); break;
+            case 10: SmallMergeInsertion<10>::sort(first, items, pairOf, comp, count); break;
+            case 11: SmallMergeInsertion<11>::sort(first, items, pairOf, comp, count); break;
+            case 12: SmallMergeInsertion<12>::sort(first, items, pairOf, comp, count); break;
+            case 13: SmallMergeInsertion<13>::sort(first, items, pairOf, comp, count); break;
+            case 14: SmallMergeInsertion<14>::sort(first, items, pairOf, comp, count); break;
+            case 15: SmallMergeInsertion<15>::sort(first, items, pairOf, comp, count); break;
+            case 16: SmallMergeInsertion<16>::sort(first, items, pairOf, comp, count); break;
+            default: break;
+        }
+    }
+
+    // Searches each batch element in the main chain as it was before the
+    // batch, so the searches are independent and only read the chain.
+    template <typename RandomIt, typename Compare, typename Chain>
+    struct BatchSearchTask {
+        RandomIt first;
+        const Chain *chain;
+        const std::vector<size_t> *items;
+        const std::vector<size_t> *bounds;
+        std::vector<size_t> *gaps;
+        Compare *comp;
+        size_t comparisons;
+
+        static void run(void *ctx, size_t begin, size_t end) {
+            BatchSearchTask *t = static_cast<BatchSearchTask *>(ctx);
+            size_t local = 0;
+            ComparisonCount count(local);
+
+            for (size_t j = begin; j < end; ++j)
+                (*t->gaps)[j] = __fordJohnsonSearch(t->first, *t->chain, (*t->items)[j], (*t->bounds)[j], *t->comp, count);
+            __sync_fetch_and_add(&t->comparisons, local);
+        }
+    };
+
+    struct GapLess {
+        const std::vector<size_t> *gaps;
+        bool operator()(size_t a, size_t b) const {
+            return (*gaps)[a] < (*gaps)[b] || ((*gaps)[a] == (*gaps)[b] && a < b);
+        }
+    };
+
+    // Inserts pend elements hi down to lo (1-based, one Jacobsthal group) at
+    // once: every element is searched concurrently against the chain as it
+    // stood before the group, up to its partner's position there. Elements
+    // that land in the same gap are then ordered among themselves, the one
+    // step that costs comparisons the sequential insertion would not have
+    // made, and all are inserted from the back so earlier positions stay
+    // valid.
+    template <typename Chain, typename RandomIt, typename Compare, typename Counter>
+    void __fordJohnsonInsertBatch(RandomIt first, FordJohnsonWorkspace<Chain>& ws,
+                                  const size_t *pend, size_t odd, size_t pairCount, size_t lo, size_t hi,
+                                  Compare& comp, Counter& count, ThreadPool& pool) {
+        Chain& mainChain = ws.chain;
+        std::vector<size_t>& items = ws.batchItems;
+        std::vector<size_t>& bounds = ws.batchBounds;
+        std::vector<size_t>& gaps = ws.batchGaps;
+        std::vector<size_t>& byGap = ws.batchOrder;
+
+        items.clear();
+        bounds.clear();
+        items.reserve(hi - lo + 1);
+        bounds.reserve(hi - lo + 1);
+        for (size_t j = hi; j >= lo; --j) {
+            size_t idx = j - 1;
+            items.push_back(idx < pairCount ? pend[idx] : odd);
+            bounds.push_back(idx < pairCount ? ws.positions.positionOf(idx) : mainChain.size());
+        }
+
+        size_t m = items.size();
+        gaps.resize(m);
+        BatchSearchTask<RandomIt, Compare, Chain> task = { first, &mainChain, &items, &bounds, &gaps, &comp, 0 };
+        pool.parallelFor(m, &BatchSearchTask<RandomIt, Compare, Chain>::run, &task);
+        count.add(task.comparisons);
+
+        byGap.resize(m);
+        for (size_t j = 0; j < m; ++j)
+            byGap[j] = j;
+        GapLess gapLess = { &gaps };
+        std::sort(byGap.begin(), byGap.end(), gapLess);
+
+        // Binary insertion sort inside each run of equal gaps.
+        for (size_t runStart = 0; runStart < m; ) {
+            size_t runEnd = runStart + 1;
+            while (runEnd < m && gaps[byGap[runEnd]] == gaps[byGap[runStart]])
+                ++runEnd;
+            for (size_t r = runStart + 1; r < runEnd; ++r) {
+                size_t moving = byGap[r];
+                size_t l = runStart, h = r;
+                while (l < h) {
+                    size_t mid = (l + h) / 2;
+                    if (comp(first[items[byGap[mid]]], first[items[moving]]))
+                        l = mid + 1;
+                    else
+                        h = mid;
+                    count.tick();
+                }
+                for (size_t q = r; q > l; --q)
+                    byGap[q] = byGap[q - 1];
+                byGap[l] = moving;
+            }
+            runStart = runEnd;
+        }
+
+        for (size_t r = m; r > 0; --r) {
+            size_t j = byGap[r - 1];
+            mainChain.insert(gaps[j], items[j]);
+            ws.positions.inserted(gaps[j]);
+        }
+    }
+
+    // Sorts the n elements first[items[0]], first[items[1]], ... by
+    // rewriting `items` in sorted order. The winners handed down live in
+    // `arena`, and the rest of the arena is left to the levels below. Once
+    // the winners come back sorted, pairOf maps each one to its pair, so
+    // every loser and its partner are found by index rather than by
+    // searching for their values. Elements are never copied or moved. With a
+    // pool, large levels pair up and insert their Jacobsthal groups in
+    // parallel.
+    template <typename Chain, typename RandomIt, typename Compare, typename Counter>
+    void __fordJohnsonLevel(RandomIt first, size_t *items, size_t n, size_t *arena,
+                            FordJohnsonWorkspace<Chain>& ws, Compare& comp, Counter& count,
+                            ThreadPool *pool) {
+        if (n <= 1) return;
+        if (n <= FJ_SMALL_MAX) {
+            __PMM_PROFILE_LEVEL(ws, n);
+            __PMM_PROFILE_PHASE(FJ_PHASE_BASE, n);
+            __fordJohnsonSmall(first, items, n, &ws.pairOf[0], comp, count);
+            return;
+        }
+
+        size_t pairCount = n / 2;
+        size_t *winners = arena;
+        __PMM_PROFILE_LEVEL(ws, n);
+
+        // Afterwards items[2i] is the loser and items[2i + 1] the winner of pair i.
+        __PMM_PROFILE_PHASE(FJ_PHASE_PAIRING, n);
+        __PMM_PROFILE_MOVED(pairCount);
+        if (pool && pairCount >= FJ_PARALLEL_MIN_PAIRS) {
+            PairingTask<RandomIt, Compare> task = { first, items, winners, &comp };
+            pool->parallelFor(pairCount, &PairingTask<RandomIt, Compare>::run, &task);
+        } else {
+            __fordJohnsonPairUp(first, items, winners, comp, 0, pairCount);
+        }
+        count.add(pairCount); // one comparison per pair
+        __PMM_PROFILE_STOP();
+
+        __fordJohnsonLevel<Chain>(first, winners, pairCount, arena + pairCount, ws, comp, count, pool);
+
+        // Written only now: the levels below reuse the entries of their own
+        // winners, which are a subset of ours.
+        __PMM_PROFILE_PHASE(FJ_PHASE_EXTRACTION, pairCount);
+        __PMM_PROFILE_MOVED(3 * pairCount + 1);
+        for (size_t i = 0; i < pairCount; ++i)
+            ws.pairOf[items[2 * i + 1]] = i;
+
+        // The sorted winners form the main chain; their slots are then reused
+        // for the pend chain, pend[k] being the loser of the k-th smallest
+        // winner. An odd element out goes last and has no partner.
+        Chain& mainChain = ws.chain;
+        size_t *pend = winners;
+        size_t odd = items[n - 1];
+        size_t pendingCount = pairCount + n % 2;
+
+        mainChain.clear();
+        for (size_t k = 0; k < pairCount; ++k) {
+            mainChain.push_back(winners[k]);
+            pend[k] = items[2 * ws.pairOf[winners[k]]];
+        }
+
+        mainChain.insert(0, pend[0]);
+        ws.positions.reset(pairCount);
+
+        // Jacobsthal groups: pend elements (t_{k-1}, t_k], 1-based, each
+        // inserted from its top down; t = 1, 3, 5, 11, 21, ...
+        size_t prevBound = 1;
+        size_t bound = 3;
+        for (size_t lo = 2; lo <= pendingCount; ) {
+            size_t hi = bound < pendingCount ? bound : pendingCount;
+
+            if (pool && hi - lo + 1 >= FJ_PARALLEL_MIN_BATCH) {
+                __PMM_PROFILE_PHASE(FJ_PHASE_BATCH, hi - lo + 1);
+                __PMM_PROFILE_MOVED(5 * (hi - lo + 1)); // four buffers, then the chain
+                __fordJohnsonInsertBatch(first, ws, pend, odd, pairCount, lo, hi, comp, count, *pool);
+            } else {
+                __PMM_PROFILE_PHASE(FJ_PHASE_INSERTION, hi - lo + 1);
+                __PMM_PROFILE_MOVED(hi - lo + 1);
+                for (size_t j = hi; j >= lo; --j) {
+                    size_t idx = j - 1;
+                    size_t loser = idx < pairCount ? pend[idx] : odd;
+                    size_t partnerPos = idx < pairCount ? ws.positions.positionOf(idx) : mainChain.size();
+
+                    size_t pos = __fordJohnsonSearch(first, mainChain, loser, partnerPos, comp, count);
+                    mainChain.insert(pos, loser);
+                    ws.positions.inserted(pos);
+                }
+            }
+
+            lo = hi + 1;
+            size_t next = bound + 2 * prevBound;
+            prevBound = bound;
+            bound = next;
+        }
+
+        __PMM_PROFILE_PHASE(FJ_PHASE_EXTRACTION, 0);
+        __PMM_PROFILE_MOVED(n);
+        size_t *out = items;
+        for (typename Chain::const_iterator it = mainChain.begin(); it != mainChain.end(); ++it)
+            *out++ = *it;
+    }
+
+    // Ford-Johnson merge-insertion over [first, last): writes to `order` the
+    // permutation that sorts the range under `comp` (first[order[0]] is the
+    // smallest) and leaves the range untouched. `ws` and `order` may be
+    // reused across sorts; fordJohnsonOrderWith() allocates fresh ones. `Chain` is the main-chain
+    // sequence of positions: anything with size(), at(), insert(index, value),
+    // push_back(), clear() and forward const_iterators, e.g.
+    // BlockedVector<size_t>.
+    //
+    // With a pool the sort runs in parallel mode; `comp` must then be safe to
+    // call from several threads. Parallel insertion can spend a few more
+    // comparisons than the sequential bound (see __fordJohnsonInsertBatch),
+    // and the counter reports the actual number.
+    template <typename Chain, typename RandomIt, typename Compare, typename Counter>
+    void fordJohnsonOrderInto(RandomIt first, RandomIt last, Compare comp, Counter count,
+                              FordJohnsonWorkspace<Chain>& ws, std::vector<size_t>& order,
+                              ThreadPool *pool = NULL) {
+        size_t n = static_cast<size_t>(last - first);
+        order.resize(n);
+        for (size_t i = 0; i < n; ++i)
+            order[i] = i;
+        if (n < 2)
+            return;
+
+        ws.prepare(n);
+#if defined(_PMM_PROFILE)
+        if (ws.profile) {
+            ProfiledCount<Counter> profiled(count, *ws.profile);
+            ws.profile->sortStarted();
+            __fordJohnsonLevel<Chain>(first, &order[0], n, &ws.arena[0], ws, comp, profiled, pool);
+            return;
+        }
+#endif
+        __fordJohnsonLevel<Chain>(first, &order[0], n, &ws.arena[0], ws, comp, count, pool);
+    }
+
+    template <typename Chain, typename RandomIt, typename Compare, typename Counter>
+    std::vector<size_t> fordJohnsonOrderWith(RandomIt first, RandomIt last, Compare comp, Counter count,
+                                             ThreadPool *pool = NULL) {
+        std::vector<size_t> order;
+        FordJohnsonWorkspace<Chain> ws;
+        fordJohnsonOrderInto(first, last, comp, count, ws, order, pool);
+        return order;
+    }
+
+    template <typename RandomIt, typename Compare, typename Counter>
+    std::vector<size_t> fordJohnsonOrder(RandomIt first, RandomIt last, Compare comp, Counter count,
+                                         ThreadPool *pool = NULL) {
+        return fordJohnsonOrderWith<BlockedVector<size_t> >(first, last, comp, count, pool);
+    }
+
+    // Rearranges first[0 .. order.size()) so that first[i] holds what was at
+    // first[order[i]], following the permutation's cycles so each element
+    // moves once (a cycle of length L costs L + 1 assignments). Consumes
+    // `order`: a visited slot is marked by pointing it at itself.
+    template <typename RandomIt>
+    void applyPermutation(RandomIt first, std::vector<size_t>& order) {
+        typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+
+        for (size_t start = 0; start < order.size(); ++start) {
+            if (order[start] == start)
+                continue;
+            value_type held = first[start];
+            size_t dst = start;
+            while (order[dst] != start) {
+                size_t src = order[dst];
+                first[dst] = first[src];
+                order[dst] = dst;
+                dst = src;
+            }
+            first[dst] = held;
+            order[dst] = dst;
+        }
+    }
+
+    // Sorts [first, last) in place: the engine only shuffles indices, and
+    // the elements are moved once at the end.
+    template <typename RandomIt, typename Compare, typename Counter>
+    void fordJohnsonSort(RandomIt first, RandomIt last, Compare comp, Counter count, ThreadPool *pool = NULL) {
+        std::vector<size_t> order = fordJohnsonOrder(first, last, comp, count, pool);
+        applyPermutation(first, order);
+    }
+
+    // Same, with caller-owned scratch that keeps its capacity for the next
+    // sort.
+    template <typename RandomIt, typename Compare, typename Counter>
+    void fordJohnsonSort(RandomIt first, RandomIt last, Compare comp, Counter count,
+                         FordJohnsonWorkspace<BlockedVector<size_t> >& ws, std::vector<size_t>& order,
+                         ThreadPool *pool = NULL) {
+        fordJohnsonOrderInto(first, last, comp, count, ws, order, pool);
+        applyPermutation(first, order);
+    }
+
+    template <typename RandomIt, typename Compare>
+    void fordJohnsonSort(RandomIt first, RandomIt last, Compare comp) {
+        fordJohnsonSort(first, last, comp, NoComparisonCount());
+    }
+
+    template <typename RandomIt>
+    void fordJohnsonSort(RandomIt first, RandomIt last) {
+        typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+        fordJohnsonSort(first, last, std::less<value_type>(), NoComparisonCount());
+    }
+
+    // Applies `comp` to what two iterators point at.
+    template <typename Iterator, typename Compare>
+    struct DereferenceCompare {
+        Compare comp;
+
+        explicit DereferenceCompare(Compare c) : comp(c) {}
+        bool operator()(Iterator a, Iterator b) const { return comp(*a, *b); }
+    };
+
+    // Sorts a std::list: the engine runs over a vector of the list's
+    // iterators with a node-based main chain (an IndexedSkipList), and the
+    // sorted order is applied by splicing the list's own nodes, so no element
+    // is copied.
+    template <typename T, typename Alloc, typename Compare, typename Counter>
+    void fordJohnsonSortList(std::list<T, Alloc>& lst, Compare comp, Counter count,
+                             FordJohnsonWorkspace<IndexedSkipList<size_t> >& ws, std::vector<size_t>& order,
+                             std::vector<typename std::list<T, Alloc>::iterator>& nodes, ThreadPool *pool = NULL) {
+        typedef typename std::list<T, Alloc>::iterator Iterator;
+
+        nodes.clear();
+        nodes.reserve(lst.size());
+        for (Iterator it = lst.begin(); it != lst.end(); ++it)
+            nodes.push_back(it);
+
+        fordJohnsonOrderInto(nodes.begin(), nodes.end(), DereferenceCompare<Iterator, Compare>(comp), count,
+                             ws, order, pool);
+        std::list<T, Alloc> sorted;
+        for (size_t i = 0; i < order.size(); ++i)
+            sorted.splice(sorted.end(), lst, nodes[order[i]]);
+        lst.swap(sorted);
+    }
+
+    // Same, with scratch allocated for this one sort.
+    template <typename T, typename Alloc, typename Compare, typename Counter>
+    void fordJohnsonSortList(std::list<T, Alloc>& lst, Compare comp, Counter count, ThreadPool *pool = NULL) {
+        FordJohnsonWorkspace<IndexedSkipList<size_t> > ws;
+        std::vector<size_t> order;
+        std::vector<typename std::list<T, Alloc>::iterator> nodes;
+        fordJohnsonSortList(lst, comp, count, ws, order, nodes, pool);
+    }
+
+    // Compares two indices by the keys they refer to.
+    template <typename KeyIt, typename Compare>
+    struct IndirectCompare {
+        KeyIt keys;
+        Compare comp;
+
+        IndirectCompare(KeyIt k, Compare c) : keys(k), comp(c) {}
+        bool operator()(size_t a, size_t b) const { return comp(keys[a], keys[b]); }
+    };
+
+    // Indirect sort: reorders the index array [first, last) so that
+    // keys[first[0]], keys[first[1]], ... ascend. The keys are only read, so
+    // one key array can serve any number of index subsets.
+    template <typename IndexIt, typename KeyIt, typename Compare, typename Counter>
+    void fordJohnsonSortIndices(IndexIt first, IndexIt last, KeyIt keys, Compare comp, Counter count,
+                                ThreadPool *pool = NULL) {
+        fordJohnsonSort(first, last, IndirectCompare<KeyIt, Compare>(keys, comp), count, pool);
+    }
+
+    // Key plus payload: sorts [keys, keysLast) and moves payloads[i] along
+    // with keys[i]. Records are compared through their keys only and each
+    // payload is moved once, after the sort, whatever its size.
+    template <typename KeyIt, typename PayloadIt, typename Compare, typename Counter>
+    void fordJohnsonSortByKey(KeyIt keys, KeyIt keysLast, PayloadIt payloads, Compare comp, Counter count,
+                              ThreadPool *pool = NULL) {
+        std::vector<size_t> order = fordJohnsonOrder(keys, keysLast, comp, count, pool);
+        std::vector<size_t> orderCopy(order);
+
+        applyPermutation(payloads, order);
+        applyPermutation(keys, orderCopy);
+    }
+
+    // Orders runs by their first elements; runs of equivalent elements by
+    // where they start, which is what makes the sort stable.
+    template <typename RandomIt, typename Compare, typename Equal>
+    struct RunStartCompare {
+        RandomIt first;
+        Compare comp;
+        Equal equal;
+
+        bool operator()(size_t a, size_t b) const {
+            return equal(first[a], first[b]) ? a < b : comp(first[a], first[b]);
+        }
+    };
+
+    // Stable merge-insertion over [first, last), duplicates allowed: writes
+    // to `order` the sorting permutation, in which equivalent elements keep
+    // their input order, and returns the number of runs sorted. A pre-pass
+    // collapses each run of adjacent equivalent elements into one, so a
+    // long run costs one insertion rather than one per element; the runs
+    // are then sorted by their first elements and expanded. `equal` must
+    // agree with `comp`'s equivalence and should be cheap, such as
+    // operator== on integer keys: it settles ties without calling `comp`,
+    // and its calls are not counted.
+    template <typename RandomIt, typename Compare, typename Equal, typename Counter>
+    size_t fordJohnsonStableOrderInto(RandomIt first, RandomIt last, Compare comp, Equal equal, Counter count,
+                                      FordJohnsonWorkspace<BlockedVector<size_t> >& ws, std::vector<size_t>& order,
+                                      ThreadPool *pool = NULL) {
+        size_t n = static_cast<size_t>(last - first);
+        std::vector<size_t>& starts = ws.runStarts;
+
+        starts.clear();
+        for (size_t i = 0; i < n; ++i) {
+            if (i == 0 || !equal(first[i - 1], first[i]))
+                starts.push_back(i);
+        }
+        size_t runs = starts.size();
+
+        RunStartCompare<RandomIt, Compare, Equal> byStart = { first, comp, equal };
+        fordJohnsonOrderInto(starts.begin(), starts.end(), byStart, count, ws, ws.runOrder, pool);
+
+        starts.push_back(n); // so run r ends where run r + 1 starts
+        order.resize(n);
+        size_t out = 0;
+        for (size_t r = 0; r < runs; ++r) {
+            size_t run = ws.runOrder[r];
+            for (size_t i = starts[run]; i < starts[run + 1]; ++i)
+                order[out++] = i;
+        }
+        return runs;
+    }
+
+    // Sorts [first, last) stably in place; see fordJohnsonStableOrderInto.
+    template <typename RandomIt, typename Compare, typename Equal, typename Counter>
+    size_t fordJohnsonStableSort(RandomIt first, RandomIt last, Compare comp, Equal equal, Counter count,
+                                 ThreadPool *pool = NULL) {
+        FordJohnsonWorkspace<BlockedVector<size_t> > ws;
+        std::vector<size_t> order;
+        size_t runs = fordJohnsonStableOrderInto(first, last, comp, equal, count, ws, order, pool);
+        applyPermutation(first, order);
+        return runs;
+    }
+}
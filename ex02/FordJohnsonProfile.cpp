@@ -0,0 +1,83 @@
+#include "FordJohnsonProfile.hpp"
+
+namespace PmergeMe {
+    namespace {
+        const char *_nsPhaseNames[] = { "pairing", "extraction", "insertion", "batch", "base" };
+    }
+
+    const char *phaseName(e_fj_phase phase) {
+        return _nsPhaseNames[phase];
+    }
+
+    FordJohnsonPhaseStats::FordJohnsonPhaseStats()
+        : elements(0), comparisons(0), moves(0), allocations(0), elapsedNs(0) {}
+
+    FordJohnsonLevelStats::FordJohnsonLevelStats() : elements(0) {}
+
+    FordJohnsonProfile::FordJohnsonProfile() : _levels(), _sorts(0), _comparisons(0), _depth(0) {}
+
+    void FordJohnsonProfile::clear(void) {
+        _levels.clear();
+        _sorts = 0;
+        _comparisons = 0;
+        _depth = 0;
+    }
+
+    size_t FordJohnsonProfile::sorts(void) const {
+        return _sorts;
+    }
+
+    size_t FordJohnsonProfile::comparisons(void) const {
+        return _comparisons;
+    }
+
+    std::vector<FordJohnsonLevelStats> const &FordJohnsonProfile::levels(void) const {
+        return _levels;
+    }
+
+    void FordJohnsonProfile::sortStarted(void) {
+        ++_sorts;
+        _depth = 0;
+    }
+
+    size_t FordJohnsonProfile::enterLevel(size_t elements) {
+        level(_depth).elements += elements;
+        return _depth++;
+    }
+
+    void FordJohnsonProfile::leaveLevel(void) {
+        --_depth;
+    }
+
+    FordJohnsonLevelStats &FordJohnsonProfile::level(size_t depth) {
+        if (_levels.size() <= depth)
+            _levels.resize(depth + 1);
+        return _levels[depth];
+    }
+
+    void FordJohnsonProfile::writeJson(Perf::JsonWriter &json) const {
+        json.beginObject();
+        json.field("sorts", _sorts);
+        json.field("comparisons", _comparisons);
+        json.key("levels").beginArray();
+        for (size_t d = 0; d < _levels.size(); ++d) {
+            FordJohnsonLevelStats const &level = _levels[d];
+            json.beginObject();
+            json.field("depth", d);
+            json.field("elements", level.elements);
+            for (int p = 0; p < FJ_PHASE_COUNT; ++p) {
+                FordJohnsonPhaseStats const &phase = level.phases[p];
+                json.key(_nsPhaseNames[p]).beginObject();
+                json.field("elements", phase.elements);
+                json.field("comparisons", phase.comparisons);
+                json.field("moves", phase.moves);
+                json.field("allocations", phase.allocations);
+                json.field("ns", phase.elapsedNs);
+                json.endObject();
+            }
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+    }
+}
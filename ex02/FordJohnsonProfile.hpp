@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+#include "Perf.hpp"
+
+namespace PmergeMe {
+    enum e_fj_phase {
+        FJ_PHASE_PAIRING,    // one comparison per pair, winners written out
+        FJ_PHASE_EXTRACTION, // main and pend chains from the sorted winners, and the level's result
+        FJ_PHASE_INSERTION,  // Jacobsthal groups inserted one loser at a time
+        FJ_PHASE_BATCH,      // Jacobsthal groups inserted as parallel batches
+        FJ_PHASE_BASE,       // a small level and all below it, unrolled; moves are not counted
+        FJ_PHASE_COUNT
+    };
+
+    const char *phaseName(e_fj_phase phase);
+
+    struct FordJohnsonPhaseStats {
+        size_t elements;    // elements the phase handled
+        size_t comparisons;
+        size_t moves;       // index entries written; a chain insert counts once, pair swaps not at all
+        size_t allocations; // main-chain allocations and batch buffer growths
+        uint64_t elapsedNs;
+
+        FordJohnsonPhaseStats();
+    };
+
+    struct FordJohnsonLevelStats {
+        size_t elements;
+        FordJohnsonPhaseStats phases[FJ_PHASE_COUNT];
+
+        FordJohnsonLevelStats();
+    };
+
+    // Where Ford-Johnson sorts spend their comparisons and time, by
+    // recursion depth (0 sorts the whole input, each level below sorts the
+    // winners of the one above) and phase, summed over the sorts since
+    // clear(). Only builds with _PMM_PROFILE (make profile) record anything:
+    // point a FordJohnsonWorkspace's `profile` at one and the engine's hooks,
+    // compiled out otherwise, fill it in. Not thread-safe; one per workspace.
+    class FordJohnsonProfile {
+    public:
+        FordJohnsonProfile();
+
+        void clear(void);
+
+        size_t sorts(void) const;
+        size_t comparisons(void) const;
+        std::vector<FordJohnsonLevelStats> const &levels(void) const;
+
+        // Engine hooks.
+        void sortStarted(void);
+        void compared(size_t n) { _comparisons += n; }
+        size_t enterLevel(size_t elements); // returns the level's depth
+        void leaveLevel(void);
+        FordJohnsonLevelStats &level(size_t depth);
+
+        // One JSON object: the totals, then one entry per depth with a
+        // member per phase.
+        void writeJson(Perf::JsonWriter &json) const;
+
+    private:
+        std::vector<FordJohnsonLevelStats> _levels;
+        size_t _sorts;
+        size_t _comparisons;
+        size_t _depth;
+    };
+}
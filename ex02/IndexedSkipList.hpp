@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <iterator>
+#include <stdint.h>
+
+namespace PmergeMe {
+    // Node-based sequence with O(log n) expected positional access and
+    // insertion: a skip list whose links also record how many elements they
+    // jump over (their width). It stands in for std::list in the list sort,
+    // where every binary search probe used to be an O(n) std::advance.
+    //
+    // clear() keeps the nodes on per-level free lists for later inserts.
+    //
+    // Width convention: the head sits at position 0, element i at i + 1 and a
+    // virtual tail at size() + 1; a link to NULL spans up to the tail.
+    template <typename T>
+    class IndexedSkipList {
+    private:
+        struct Node;
+
+        struct Link {
+            Node *next;
+            size_t width;
+        };
+
+        struct Node {
+            T value;
+            int level;
+            Link links[1]; // `level` links are allocated
+        };
+
+        enum { MAX_LEVEL = 32 };
+
+    public:
+        class const_iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef T value_type;
+            typedef ptrdiff_t difference_type;
+            typedef T const *pointer;
+            typedef T const &reference;
+
+            const_iterator() : _node(NULL) {}
+            T const &operator*() const { return _node->value; }
+            T const *operator->() const { return &_node->value; }
+            const_iterator &operator++() { _node = _node->links[0].next; return *this; }
+            bool operator==(const_iterator const &rhs) const { return _node == rhs._node; }
+            bool operator!=(const_iterator const &rhs) const { return _node != rhs._node; }
+        private:
+            friend class IndexedSkipList;
+            explicit const_iterator(Node *node) : _node(node) {}
+            Node *_node;
+        };
+
+        IndexedSkipList() : _size(0), _level(1), _rng(0x2545F4914F6CDD1DULL), _allocations(0) {
+            resetHead_impl();
+            for (int lvl = 0; lvl < MAX_LEVEL; ++lvl)
+                _free[lvl] = NULL;
+        }
+
+        ~IndexedSkipList() {
+            clear();
+            for (int lvl = 0; lvl < MAX_LEVEL; ++lvl) {
+                while (_free[lvl]) {
+                    Node *next = _free[lvl]->links[0].next;
+                    ::operator delete(_free[lvl]);
+                    _free[lvl] = next;
+                }
+            }
+        }
+
+        size_t size(void) const { return _size; }
+        bool empty(void) const { return _size == 0; }
+        // Nodes allocated so far; reused free nodes are not counted.
+        size_t allocations(void) const { return _allocations; }
+
+        const_iterator begin(void) const { return const_iterator(_head[0].next); }
+        const_iterator end(void) const { return const_iterator(NULL); }
+
+        T const &at(size_t index) const {
+            const Link *x = _head;
+            Node *node = NULL;
+            size_t pos = 0;
+            size_t target = index + 1;
+
+            for (int lvl = _level - 1; lvl >= 0; --lvl) {
+                while (x[lvl].next && pos + x[lvl].width <= target) {
+                    pos += x[lvl].width;
+                    node = x[lvl].next;
+                    x = node->links;
+                }
+            }
+            return node->value;
+        }
+
+        // Inserts before the element at `index`; index == size() appends.
+        void insert(size_t index, T const &value) {
+            Link *update[MAX_LEVEL];
+            size_t updatePos[MAX_LEVEL];
+            Link *x = _head;
+            size_t pos = 0;
+
+            for (int lvl = _level - 1; lvl >= 0; --lvl) {
+                while (x[lvl].next && pos + x[lvl].width <= index) {
+                    pos += x[lvl].width;
+                    x = x[lvl].next->links;
+                }
+                update[lvl] = x;
+                updatePos[lvl] = pos;
+            }
+
+            int level = randomLevel_impl();
+            if (level > _level) {
+                for (int lvl = _level; lvl < level; ++lvl) {
+                    _head[lvl].next = NULL;
+                    _head[lvl].width = _size + 1;
+                    update[lvl] = _head;
+                    updatePos[lvl] = 0;
+                }
+                _level = level;
+            }
+
+            Node *node = _free[level - 1];
+            if (node)
+                _free[level - 1] = node->links[0].next;
+            else {
+                node = static_cast<Node *>(::operator new(sizeof(Node) + (level - 1) * sizeof(Link)));
+                ++_allocations;
+            }
+            new (&node->value) T(value);
+            node->level = level;
+
+            for (int lvl = 0; lvl < level; ++lvl) {
+                size_t before = index - updatePos[lvl]; // elements between update[lvl] and the new node
+                node->links[lvl].next = update[lvl][lvl].next;
+                node->links[lvl].width = update[lvl][lvl].width - before;
+                update[lvl][lvl].next = node;
+                update[lvl][lvl].width = before + 1;
+            }
+            for (int lvl = level; lvl < _level; ++lvl) {
+                update[lvl][lvl].width += 1;
+            }
+            ++_size;
+        }
+
+        void push_back(T const &value) {
+            insert(_size, value);
+        }
+
+        void clear(void) {
+            Node *node = _head[0].next;
+            while (node) {
+                Node *next = node->links[0].next;
+                node->value.~T();
+                node->links[0].next = _free[node->level - 1];
+                _free[node->level - 1] = node;
+                node = next;
+            }
+            _size = 0;
+            _level = 1;
+            resetHead_impl();
+        }
+
+    private:
+        Link _head[MAX_LEVEL];
+        Node *_free[MAX_LEVEL]; // cleared nodes by level, chained through links[0]
+        size_t _size;
+        int _level;
+        uint64_t _rng;
+        size_t _allocations;
+
+        void resetHead_impl(void) {
+            for (int lvl = 0; lvl < MAX_LEVEL; ++lvl) {
+                _head[lvl].next = NULL;
+                _head[lvl].width = 1;
+            }
+        }
+
+        // Geometric with p = 1/4: about 1.33 links per node.
+        int randomLevel_impl(void) {
+            _rng ^= _rng >> 12;
+            _rng ^= _rng << 25;
+            _rng ^= _rng >> 27;
+            uint64_t bits = _rng * 2685821657736338717ULL;
+
+            int level = 1;
+            while ((bits & 3) == 0 && level < MAX_LEVEL) {
+                ++level;
+                bits >>= 2;
+            }
+            return level;
+        }
+
+        IndexedSkipList(const IndexedSkipList &other);
+        IndexedSkipList &operator=(const IndexedSkipList &rhs);
+    };
+}
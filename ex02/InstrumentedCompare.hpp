@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include "Perf.hpp"
+
+namespace PmergeMe {
+    // What an InstrumentedCompare saw. The counters are updated atomically,
+    // so threads of a parallel sort can share one block.
+    struct ComparisonStats {
+        size_t calls;       // comparisons the algorithm asked for
+        uint64_t compareNs; // time spent inside the wrapped comparator
+
+        ComparisonStats() : calls(0), compareNs(0) {}
+    };
+
+    // Comparator adapter that counts every call and times the wrapped
+    // comparator with the monotonic clock. Timing costs two clock reads per
+    // comparison, so it is meant for comparators far slower than that; the
+    // sort's own bookkeeping is its wall time minus compareNs.
+    template <typename Compare>
+    class InstrumentedCompare {
+    public:
+        InstrumentedCompare(Compare comp, ComparisonStats &stats) : _comp(comp), _stats(&stats) {}
+
+        template <typename T>
+        bool operator()(T const &a, T const &b) const {
+            __sync_fetch_and_add(&_stats->calls, 1);
+            uint64_t start = Perf::nowNs();
+            bool less = _comp(a, b);
+            __sync_fetch_and_add(&_stats->compareNs, Perf::nowNs() - start);
+            return less;
+        }
+
+    private:
+        Compare _comp;
+        ComparisonStats *_stats;
+    };
+}
@@ -0,0 +1,119 @@
+#include "IntSet.hpp"
+
+namespace PmergeMe {
+    namespace {
+        const uint32_t _nsEmptySlot = 0xFFFFFFFFU; // never a valid (non-negative int) value
+        const size_t _nsMinBitmapBits = 1 << 16;
+
+        size_t __slotOf(uint32_t value, size_t mask) {
+            return static_cast<size_t>((value * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+        }
+    }
+
+    IntSet::IntSet() : _bits(), _slots(), _count(0), _expected(0), _hashed(false) {}
+
+    void IntSet::clear(void) {
+        _bits.clear();
+        _slots.clear();
+        _count = 0;
+        _expected = 0;
+        _hashed = false;
+    }
+
+    void IntSet::reserve(size_t expected) {
+        _expected = expected;
+        if (_hashed)
+            growTable_impl(2 * expected);
+    }
+
+    size_t IntSet::size(void) const {
+        return _count;
+    }
+
+    bool IntSet::insert(int value) {
+        uint32_t v = static_cast<uint32_t>(value);
+
+        if (!_hashed) {
+            size_t word = v / 64;
+            if (word >= _bits.size()) {
+                size_t limit = 32 * (_expected > _count ? _expected : _count);
+                if (limit < _nsMinBitmapBits)
+                    limit = _nsMinBitmapBits;
+
+                if (v >= limit) {
+                    switchToHash_impl();
+                    return insertHashed_impl(v);
+                }
+                size_t words = _bits.size() ? _bits.size() : 64;
+                while (words <= word)
+                    words *= 2;
+                _bits.resize(words, 0);
+            }
+
+            uint64_t bit = 1ULL << (v % 64);
+            if (_bits[word] & bit)
+                return false;
+            _bits[word] |= bit;
+            ++_count;
+            return true;
+        }
+        return insertHashed_impl(v);
+    }
+
+    bool IntSet::insertHashed_impl(uint32_t value) {
+        if (2 * (_count + 1) > _slots.size())
+            growTable_impl(2 * (_count + 1));
+
+        size_t mask = _slots.size() - 1;
+        size_t i = __slotOf(value, mask);
+        while (_slots[i] != _nsEmptySlot) {
+            if (_slots[i] == value)
+                return false;
+            i = (i + 1) & mask;
+        }
+        _slots[i] = value;
+        ++_count;
+        return true;
+    }
+
+    // Rehashes into a power-of-two table of at least `minSlots` slots.
+    void IntSet::growTable_impl(size_t minSlots) {
+        size_t slots = 16;
+        while (slots < minSlots)
+            slots *= 2;
+        if (slots <= _slots.size())
+            return;
+
+        std::vector<uint32_t> old(slots, _nsEmptySlot);
+        old.swap(_slots);
+
+        size_t mask = _slots.size() - 1;
+        for (size_t j = 0; j < old.size(); ++j) {
+            if (old[j] == _nsEmptySlot)
+                continue;
+            size_t i = __slotOf(old[j], mask);
+            while (_slots[i] != _nsEmptySlot)
+                i = (i + 1) & mask;
+            _slots[i] = old[j];
+        }
+    }
+
+    void IntSet::switchToHash_impl(void) {
+        size_t expected = _expected > _count ? _expected : _count;
+        _slots.assign(0, 0);
+        growTable_impl(2 * (expected + 1));
+
+        size_t mask = _slots.size() - 1;
+        for (size_t word = 0; word < _bits.size(); ++word) {
+            for (uint64_t w = _bits[word]; w; w &= w - 1) {
+                uint32_t value = static_cast<uint32_t>(word * 64 + __builtin_ctzll(w));
+                size_t i = __slotOf(value, mask);
+                while (_slots[i] != _nsEmptySlot)
+                    i = (i + 1) & mask;
+                _slots[i] = value;
+            }
+        }
+        std::vector<uint64_t>().swap(_bits);
+        _hashed = true;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+namespace PmergeMe {
+    // Set of non-negative ints, used to reject duplicate input values.
+    //
+    // Starts as a bitmap over [0, max value seen] and stays one while that
+    // costs no more than a hash table would (about 32 bits per expected
+    // element). A value past that bound moves the set to an open-addressing
+    // hash table with linear probing. Both make insert O(1), where the old
+    // std::find over the input was O(n).
+    class IntSet {
+    public:
+        IntSet();
+
+        void clear(void);
+        void reserve(size_t expected); // sizes the bitmap bound and the table
+        size_t size(void) const;
+
+        bool insert(int value); // false if value was already present
+
+    private:
+        std::vector<uint64_t> _bits;
+        std::vector<uint32_t> _slots;
+        size_t _count;
+        size_t _expected;
+        bool _hashed;
+
+        bool insertHashed_impl(uint32_t value);
+        void growTable_impl(size_t minSlots);
+        void switchToHash_impl(void);
+    };
+}
@@ -0,0 +1,51 @@
+#include "MappedFile.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace PmergeMe {
+    MappedFile::MappedFile() : _data(NULL), _size(0) {}
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    bool MappedFile::open(const char *path) {
+        close();
+
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+
+        if (st.st_size > 0) {
+            void *addr = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                return false;
+            }
+            // Parsing reads the file front to back exactly once.
+            madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            _data = static_cast<const char *>(addr);
+            _size = static_cast<size_t>(st.st_size);
+        }
+        ::close(fd); // the mapping keeps the file alive
+        return true;
+    }
+
+    void MappedFile::close(void) {
+        if (_data)
+            munmap(const_cast<char *>(_data), _size);
+        _data = NULL;
+        _size = 0;
+    }
+
+    const char *MappedFile::data(void) const { return _data; }
+    size_t MappedFile::size(void) const { return _size; }
+}
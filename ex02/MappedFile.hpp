@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+namespace PmergeMe {
+    // Read-only memory mapping of a whole file, unmapped on destruction.
+    // An empty file opens successfully with size() == 0 and data() == NULL.
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        bool open(const char *path);
+        void close(void);
+
+        const char *data(void) const;
+        size_t size(void) const;
+
+    private:
+        const char *_data;
+        size_t _size;
+
+        MappedFile(const MappedFile& other);
+        MappedFile& operator=(const MappedFile& rhs);
+    };
+}
@@ -1,4 +1,15 @@
 #include "PmergeMe.hpp"
+#include "IntSet.hpp"
+#include "MappedFile.hpp"
+#include "IndexedSkipList.hpp"
+#include "BlockedVector.hpp"
+#include "FordJohnson.hpp"
+#include "ThreadPool.hpp"
+#include "InstrumentedCompare.hpp"
+#include "SpillIO.hpp"
+#include "LoserTree.hpp"
+#include "SortStrategy.hpp"
+#include "Perf.hpp"
 #include <string>
 #include <sstream>
 #include <cstdlib>
@@ -7,15 +18,29 @@
 #include <climits>
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
 
 namespace PmergeMe {
     namespace {
-        IntVector _nsInternalV;
-        IntList _nsInternalL;
-        size_t _nsInternalCompCount = 0;
+        // Only assert builds report comparisons; elsewhere counting compiles out.
+#if defined(_PMM_ASSERT_TEST)
+        typedef ComparisonCount SortCounter;
+#else
+        typedef NoComparisonCount SortCounter;
+#endif
 
-        clock_t _nsInternalElapsedTicksV = 0;
-        clock_t _nsInternalElapsedTicksL = 0;
+        // Assert builds count comparisons, so they default to the engine
+        // that makes the fewest; elsewhere the fastest strategy is picked.
+#if defined(_PMM_ASSERT_TEST)
+        const e_sort_strategy _nsInternalDefaultStrategy = STRATEGY_MERGE_INSERTION;
+#else
+        const e_sort_strategy _nsInternalDefaultStrategy = STRATEGY_AUTO;
+#endif
 
         enum e_error_codes {
             NO_ERROR,
@@ -26,53 +51,503 @@ namespace PmergeMe {
             STREAM_FAILURE
         };
 
-        bool __parsePushValue(std::string const &token, int &errorCode) _PMM_NOEXCEPT {
-            if (token.empty()) {
+        // "12.345 us" from a nanosecond count.
+        std::string __formatMicros(uint64_t ns) {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%llu.%03llu us",
+                          static_cast<unsigned long long>(ns / 1000), static_cast<unsigned long long>(ns % 1000));
+            return buf;
+        }
+
+        bool __isSpace(char c) {
+            return c == ' ' || (c >= '\t' && c <= '\r');
+        }
+
+        // Same acceptance rules as `std::istringstream >> int` followed by a
+        // check that only whitespace remains, without building a stream.
+        bool __parseInt(const char *begin, const char *end, int &value) {
+            while (begin != end && __isSpace(*begin))
+                ++begin;
+            while (end != begin && __isSpace(end[-1]))
+                --end;
+
+            bool negative = false;
+            if (begin != end && (*begin == '+' || *begin == '-')) {
+                negative = *begin == '-';
+                ++begin;
+            }
+            if (begin == end)
+                return false;
+
+            long long parsed = 0;
+            for (; begin != end; ++begin) {
+                if (*begin < '0' || *begin > '9')
+                    return false;
+                parsed = parsed * 10 + (*begin - '0');
+                if (parsed > static_cast<long long>(INT_MAX) + 1)
+                    return false;
+            }
+            if (negative)
+                parsed = -parsed;
+            if (parsed > INT_MAX)
+                return false;
+
+            value = static_cast<int>(parsed);
+            return true;
+        }
+
+        // A decimal 64-bit key, with the same whitespace rules as
+        // __parseInt, stored in ordered form: signed keys get their sign bit
+        // flipped, so both types order as unsigned integers.
+        bool __parseKey(const char *begin, const char *end, e_key_type type, uint64_t &ordered) {
+            const uint64_t signBit = 1ULL << 63;
+            while (begin != end && __isSpace(*begin))
+                ++begin;
+            while (end != begin && __isSpace(end[-1]))
+                --end;
+
+            bool negative = false;
+            if (begin != end && (*begin == '+' || (*begin == '-' && type == SIGNED_KEYS))) {
+                negative = *begin == '-';
+                ++begin;
+            }
+            if (begin == end)
+                return false;
+
+            uint64_t limit = type == UNSIGNED_KEYS ? ~0ULL : (negative ? signBit : signBit - 1);
+            uint64_t parsed = 0;
+            for (; begin != end; ++begin) {
+                if (*begin < '0' || *begin > '9')
+                    return false;
+                uint64_t digit = static_cast<uint64_t>(*begin - '0');
+                if (parsed > (limit - digit) / 10)
+                    return false;
+                parsed = parsed * 10 + digit;
+            }
+            if (negative)
+                parsed = 0 - parsed;
+
+            ordered = type == SIGNED_KEYS ? parsed ^ signBit : parsed;
+            return true;
+        }
+
+        template <typename Sink>
+        bool __parsePushValue(const char *begin, const char *end, Sink &sink, int &errorCode) _PMM_NOEXCEPT {
+            if (begin == end) {
                 errorCode = EMPTY_STRING;
                 return false;
             }
 
-            try {
-                std::istringstream iss(token);
-                int toAppend;
-                
-                if (!(iss >> toAppend) || !(iss >> std::ws).eof()) {
+            int toAppend;
+            if (!__parseInt(begin, end, toAppend)) {
+                errorCode = INVALID_FOMRAT;
+                return false;
+            }
+
+            return sink.push(toAppend, errorCode);
+        }
+
+        // Prints the message for `errorCode`; true if ingestion may go on.
+        bool __reportError(int errorCode, std::string const &token) {
+            switch (errorCode) {
+                case EMPTY_STRING:
+                    ERRLOG("Warning: Empty string encountered. Moving on...") __ERRFLUSH();
+                    return true;
+                case INVALID_FOMRAT:
+                    ERRLOG("Error: `" << token << "`: Invalid format.") __ERRFLUSH();
+                    break;
+                case NEGATIVE_NUMBER:
+                    ERRLOG("Error: `" << token << "`: Only accepting positive integers.") __ERRFLUSH();
+                    break;
+                case DUPLICATE_VALUE:
+                    ERRLOG("Error: `" << token << "` already exists and is not allowed.") __ERRFLUSH();
+                    break;
+                default:
+                    ERRLOG("Status: Irrecoverable error encountered.") __ERRFLUSH();
+            }
+            return false;
+        }
+
+        bool __checkEnoughElements(size_t count, const char *what = "positive integers") {
+            if (count < 2) {
+                ERRLOG("Error: Not enough input elements. Need at least two " << what << ".") __ERRFLUSH();
+                return false;
+            }
+            return true;
+        }
+
+        // Parsed values go to a sink: push(value, errorCode) returns false,
+        // with the code set, to stop ingestion. Token sinks take the
+        // unparsed text instead: pushToken(begin, end, errorCode).
+        //
+        // Feeds each whitespace-separated token to `sink`.
+        template <typename TokenSink>
+        bool __forEachTextToken(const char *data, const char *end, TokenSink &sink) {
+            int errorCode = 0;
+            const char *p = data;
+            while (p != end) {
+                while (p != end && __isSpace(*p))
+                    ++p;
+                const char *tokBegin = p;
+                while (p != end && !__isSpace(*p))
+                    ++p;
+                if (p == tokBegin)
+                    continue;
+                if (!sink.pushToken(tokBegin, p, errorCode)) {
+                    __reportError(errorCode, std::string(tokBegin, p));
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Parses tokens as ints for a value sink.
+        template <typename Sink>
+        struct IntTokenSink {
+            Sink *sink;
+
+            bool pushToken(const char *begin, const char *end, int &errorCode) {
+                int value;
+                if (!__parseInt(begin, end, value)) {
                     errorCode = INVALID_FOMRAT;
                     return false;
                 }
+                return sink->push(value, errorCode);
+            }
+        };
+
+        // Feeds each whitespace-separated decimal integer to `sink`.
+        template <typename Sink>
+        bool __forEachTextValue(const char *data, const char *end, Sink &sink) {
+            IntTokenSink<Sink> ints = { &sink };
+            return __forEachTextToken(data, end, ints);
+        }
+
+        size_t __countTextTokens(const char *data, const char *end) {
+            size_t count = 0;
+            bool inToken = false;
+            for (const char *p = data; p != end; ++p) {
+                bool space = __isSpace(*p);
+                count += (!space && !inToken);
+                inToken = !space;
+            }
+            return count;
+        }
+
+        bool __checkBinarySize(size_t bytes, size_t recordSize, const char *path) {
+            if (bytes % recordSize != 0) {
+                ERRLOG("Error: `" << path << "`: size is not a multiple of " << recordSize << " bytes.") __ERRFLUSH();
+                return false;
+            }
+            return true;
+        }
+
+        // Feeds each raw little-endian int32 to `sink`.
+        template <typename Sink>
+        bool __forEachBinaryValue(const char *data, const char *end, Sink &sink) {
+            int errorCode = 0;
+            for (const char *p = data; p != end; p += 4) {
+                uint32_t raw;
+                std::memcpy(&raw, p, sizeof(raw));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                raw = __builtin_bswap32(raw);
+#endif
+                int value = static_cast<int>(raw);
+                if (!sink.push(value, errorCode)) {
+                    std::ostringstream token;
+                    token << value;
+                    __reportError(errorCode, token.str());
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Whitespace-separated decimal integers. A first pass counts the
+        // tokens so the sink's containers are sized once.
+        template <typename Sink>
+        bool __ingestText(const char *data, const char *end, Sink &sink) {
+            sink.prepare(__countTextTokens(data, end));
+            return __forEachTextValue(data, end, sink);
+        }
+
+        // Raw little-endian int32 values.
+        template <typename Sink>
+        bool __ingestBinary(const char *data, const char *end, const char *path, Sink &sink) {
+            size_t bytes = static_cast<size_t>(end - data);
+            if (!__checkBinarySize(bytes, 4, path))
+                return false;
+            sink.prepare(bytes / 4);
+            return __forEachBinaryValue(data, end, sink);
+        }
+
+        // Out-of-core sizing. A run of n ints costs about
+        // EXTERNAL_BYTES_PER_ELEMENT * n bytes while the engine sorts it (the
+        // values plus the order, arena, pairOf and main-chain indices), and
+        // every open stream holds two blocks of EXTERNAL_MIN_BLOCK to
+        // EXTERNAL_MAX_BLOCK bytes.
+        enum {
+            EXTERNAL_BYTES_PER_ELEMENT = 48,
+            EXTERNAL_MIN_BLOCK = 1 << 12,
+            EXTERNAL_MAX_BLOCK = 1 << 20
+        };
+
+        size_t __clampBlock(size_t bytes) {
+            if (bytes < EXTERNAL_MIN_BLOCK)
+                bytes = EXTERNAL_MIN_BLOCK;
+            if (bytes > EXTERNAL_MAX_BLOCK)
+                bytes = EXTERNAL_MAX_BLOCK;
+            return bytes - bytes % EXTERNAL_MIN_BLOCK;
+        }
+
+        // [begin, end) byte range of one sorted run in a spill file.
+        struct SpillRun {
+            off_t begin;
+            off_t end;
+        };
+
+        // Collects parsed values into a run; a full run is sorted by the
+        // merge-insertion engine and appended to the spill file.
+        struct RunSink {
+            std::vector<int> run;
+            size_t capacity;
+            BlockWriter *writer;
+            std::vector<SpillRun> *runs;
+            size_t count;
+            size_t *comparisons;
+            ThreadPool *pool;
 
-                if (toAppend < 0) {
+            bool push(int value, int &errorCode) {
+                if (value < 0) {
                     errorCode = NEGATIVE_NUMBER;
                     return false;
                 }
+                run.push_back(value);
+                ++count;
+                if (run.size() == capacity)
+                    spill();
+                return true;
+            }
+
+            void spill(void) {
+                if (run.empty())
+                    return;
+                fordJohnsonSort(run.begin(), run.end(), std::less<int>(),
+                                SortCounter(*comparisons), pool);
+                SpillRun spilled;
+                spilled.begin = writer->offset();
+                writer->append(&run[0], run.size() * sizeof(int));
+                spilled.end = writer->offset();
+                runs->push_back(spilled);
+                run.clear();
+            }
+        };
+
+        // Merge output bound for another spill file.
+        struct SpillSink {
+            BlockWriter *writer;
+
+            bool push(int value, int &) {
+                writer->append(&value, sizeof(value));
+                return true;
+            }
+        };
+
+        // Final merge output, in the input's format. Duplicates meet here
+        // as neighbours, wherever they were in the input.
+        struct OutputSink {
+            BlockWriter *writer;
+            e_input_format format;
+            bool started;
+            int last;
 
-                if (std::find(_nsInternalV.begin(), _nsInternalV.end(), toAppend) != _nsInternalV.end()) { // Cache goes brrrrrr
+            bool push(int value, int &errorCode) {
+                if (started && value == last) {
                     errorCode = DUPLICATE_VALUE;
                     return false;
                 }
+                started = true;
+                last = value;
 
-                _nsInternalL.push_back(toAppend);
-                _nsInternalV.push_back(toAppend);
-
+                if (format == BINARY_INPUT) {
+                    uint32_t raw = static_cast<uint32_t>(value);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                    raw = __builtin_bswap32(raw);
+#endif
+                    writer->append(&raw, sizeof(raw));
+                } else {
+                    char buf[16];
+                    int len = std::snprintf(buf, sizeof(buf), "%d\n", value);
+                    writer->append(buf, static_cast<size_t>(len));
+                }
                 return true;
-            } catch (const std::ios_base::failure& f) {
-                errorCode = STREAM_FAILURE;
-                ERRLOG(f.what()) __ERRFLUSH();
+            }
+        };
+
+        // k-way merge of runs[first, last) of `fd` into `sink` through a
+        // loser tree; each run is read through its own double buffer.
+        template <typename Sink>
+        bool __mergeRuns(IoWorker &io, int fd, std::vector<SpillRun> const &runs, size_t first, size_t last,
+                         size_t blockBytes, Sink &sink) {
+            size_t k = last - first;
+            std::vector<RunReader *> readers(k);
+            LoserTree<int, std::less<int> > tree(k, std::less<int>());
+            int errorCode = 0;
+            int value;
+            bool ok = true;
 
+            for (size_t i = 0; i < k; ++i) {
+                readers[i] = new RunReader(io, fd, runs[first + i].begin, runs[first + i].end, blockBytes);
+                if (readers[i]->next(value))
+                    tree.set(i, value);
+            }
+            tree.build();
+
+            while (!tree.empty()) {
+                size_t source = tree.winner();
+                if (!sink.push(tree.top(), errorCode)) {
+                    std::ostringstream token;
+                    token << tree.top();
+                    __reportError(errorCode, token.str());
+                    ok = false;
+                    break;
+                }
+                if (readers[source]->next(value))
+                    tree.replace(value);
+                else
+                    tree.pop();
+            }
+
+            for (size_t i = 0; i < k; ++i) {
+                if (ok && readers[i]->failed()) {
+                    ERRLOG("Error: could not read back a spilled run.") __ERRFLUSH();
+                    ok = false;
+                }
+                delete readers[i];
+            }
+            return ok;
+        }
+
+        // Spills sorted runs of `data` into `spillFd`; false once an error
+        // has been reported.
+        bool __spillRuns(IoWorker &io, int spillFd, const char *data, const char *end, const char *path,
+                         e_input_format format, size_t budget, std::vector<SpillRun> &runs,
+                         SortStats &stats, ThreadPool *pool) {
+            size_t blockBytes = __clampBlock(budget / 16);
+            BlockWriter writer(io, spillFd, 0, blockBytes);
+            RunSink sink;
+            sink.capacity = (budget - 2 * blockBytes) / EXTERNAL_BYTES_PER_ELEMENT;
+            sink.run.reserve(sink.capacity);
+            sink.writer = &writer;
+            sink.runs = &runs;
+            sink.count = 0;
+            sink.comparisons = &stats.comparisonsExternal;
+            sink.pool = pool;
+
+            bool parsed = (format == BINARY_INPUT)
+                ? __checkBinarySize(static_cast<size_t>(end - data), 4, path) && __forEachBinaryValue(data, end, sink)
+                : __forEachTextValue(data, end, sink);
+            if (!parsed)
+                return false;
+            sink.spill();
+            stats.externalCount = sink.count;
+
+            if (!writer.flush()) {
+                ERRLOG("Error: could not write a spill file.") __ERRFLUSH();
                 return false;
             }
+            return __checkEnoughElements(sink.count);
         }
 
-        void __setUp(void) {
-            _nsInternalV.clear();
-            _nsInternalL.clear();
+        // Merges groups of `fanIn` runs, alternating between the two spill
+        // files, until one final merge can take them all.
+        bool __reduceRuns(IoWorker &io, int spill[2], int &current, std::vector<SpillRun> &runs,
+                          size_t fanIn, size_t blockBytes, SortStats &stats) {
+            while (runs.size() > fanIn) {
+                int target = spill[current ^ 1];
+                std::vector<SpillRun> merged;
+
+                if (ftruncate(target, 0) != 0) {
+                    ERRLOG("Error: could not write a spill file.") __ERRFLUSH();
+                    return false;
+                }
+                BlockWriter writer(io, target, 0, blockBytes);
+                SpillSink sink = { &writer };
+                for (size_t first = 0; first < runs.size(); first += fanIn) {
+                    size_t last = std::min(first + fanIn, runs.size());
+                    SpillRun run;
+                    run.begin = writer.offset();
+                    if (!__mergeRuns(io, spill[current], runs, first, last, blockBytes, sink))
+                        return false;
+                    run.end = writer.offset();
+                    merged.push_back(run);
+                }
+                if (!writer.flush()) {
+                    ERRLOG("Error: could not write a spill file.") __ERRFLUSH();
+                    return false;
+                }
+                runs.swap(merged);
+                current ^= 1;
+                ++stats.externalPasses;
+            }
+            return true;
         }
 
-        void __tearDown(void) {
-            _nsInternalV.clear();
-            _nsInternalL.clear();
+        bool __sortFileExternally(const char *inPath, e_input_format format, const char *outPath, size_t budget,
+                                  int spill[2], SortStats &stats, ThreadPool *pool) {
+            MappedFile file;
+            if (!file.open(inPath)) {
+                ERRLOG("Error: `" << inPath << "`: could not open file.") __ERRFLUSH();
+                return false;
+            }
+
+            IoWorker io;
+            std::vector<SpillRun> runs;
+            int current = 0;
+            if (!__spillRuns(io, spill[0], file.data(), file.data() + file.size(), inPath, format, budget, runs,
+                             stats, pool))
+                return false;
+            file.close();
+            stats.externalRuns = runs.size();
+
+            // As large blocks as the budget allows with every run open at
+            // once; if that drops below the minimum, merge in several passes.
+            size_t blockBytes = __clampBlock(budget / (2 * (runs.size() + 1)));
+            size_t fanIn = budget / (2 * blockBytes) - 1;
+            if (!__reduceRuns(io, spill, current, runs, fanIn, blockBytes, stats))
+                return false;
+
+            int outFd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (outFd < 0) {
+                ERRLOG("Error: `" << outPath << "`: could not open file.") __ERRFLUSH();
+                return false;
+            }
+            bool ok;
+            {
+                BlockWriter writer(io, outFd, 0, blockBytes);
+                OutputSink sink = { &writer, format, false, 0 };
+                ok = __mergeRuns(io, spill[current], runs, 0, runs.size(), blockBytes, sink);
+                if (ok && !writer.flush()) {
+                    ERRLOG("Error: `" << outPath << "`: write failed.") __ERRFLUSH();
+                    ok = false;
+                }
+            }
+            ++stats.externalPasses;
+            close(outFd);
+            return ok;
         }
 
+        // std::less<int> that reports each call to a SortCounter, for sorts
+        // outside the engine.
+        struct CountedLess {
+            SortCounter *count;
+
+            bool operator()(int a, int b) const {
+                count->tick();
+                return a < b;
+            }
+        };
+
         void __myAssert(bool expr_) {
             if (!expr_)
                 throw std::runtime_error("Check line: ");
@@ -80,107 +555,792 @@ namespace PmergeMe {
     }
 
     bool testValidInputs(void) {
-        __setUp();
+        Sorter sorter;
         const char* input[] = {"1", "2", "3", NULL};
-        bool result = initInternals(input);
+        bool result = sorter.load(input);
         __myAssert(result == true);
-        __myAssert(_nsInternalV.size() == 3);
-        __myAssert(_nsInternalL.size() == 3);
-        __tearDown();
+        __myAssert(sorter.values().size() == 3);
+        __myAssert(sorter.list().size() == 3);
         return true;
     }
 
     bool testEmptyString(void) {
-        __setUp();
+        Sorter sorter;
         const char* input[] = {"1", "", "3", NULL};
-        bool result = initInternals(input);
+        bool result = sorter.load(input);
         __myAssert(result == true);
-        __myAssert(_nsInternalV.size() == 2);
-        __myAssert(_nsInternalL.size() == 2);
-        __tearDown();
+        __myAssert(sorter.values().size() == 2);
+        __myAssert(sorter.list().size() == 2);
         return true;
     }
 
     bool testInvalidFormat(void) {
-        __setUp();
+        Sorter sorter;
         const char* input[] = {"1", "2a", "3", NULL};
-        bool result = initInternals(input);
+        bool result = sorter.load(input);
         __myAssert(result == false);
-        __myAssert(_nsInternalV.size() == 1);
-        __myAssert(_nsInternalL.size() == 1);
-        __tearDown();
+        __myAssert(sorter.values().size() == 1);
+        __myAssert(sorter.list().size() == 1);
         return true;
     }
 
     bool testNegativeNumber(void) {
-        __setUp();
+        Sorter sorter;
         const char* input[] = {"1", "-2", "3", NULL};
-        bool result = initInternals(input);
+        bool result = sorter.load(input);
         __myAssert(result == false);
-        __myAssert(_nsInternalV.size() == 1);
-        __myAssert(_nsInternalL.size() == 1);
-        __tearDown();
+        __myAssert(sorter.values().size() == 1);
+        __myAssert(sorter.list().size() == 1);
         return true;
     }
 
     bool testDuplicateValue(void) {
-        __setUp();
+        Sorter sorter;
         const char* input[] = {"1", "2", "2", NULL};
-        bool result = initInternals(input);
+        bool result = sorter.load(input);
         __myAssert(result == false);
-        __myAssert(_nsInternalV.size() == 2);
-        __myAssert(_nsInternalL.size() == 2);
-        __tearDown();
+        __myAssert(sorter.values().size() == 2);
+        __myAssert(sorter.list().size() == 2);
         return true;
     }
 
     bool testWhitespaceHandling(void) {
-        __setUp();
+        Sorter sorter;
         const char* input[] = {"1", " 2 ", "3", NULL};
-        bool result = initInternals(input);
+        bool result = sorter.load(input);
         __myAssert(result == true);
-        __myAssert(_nsInternalV.size() == 3);
-        __myAssert(_nsInternalL.size() == 3);
-        __tearDown();
+        __myAssert(sorter.values().size() == 3);
+        __myAssert(sorter.list().size() == 3);
         return true;
     }
 
     bool testLargeNumbers(void) {
-        __setUp();
+        Sorter sorter;
         const char* input[] = {"2147483647", "1", "2", NULL};
-        bool result = initInternals(input);
+        bool result = sorter.load(input);
         __myAssert(result == true);
-        __myAssert(_nsInternalV.size() == 3);
-        __myAssert(_nsInternalL.size() == 3);
-        __tearDown();
+        __myAssert(sorter.values().size() == 3);
+        __myAssert(sorter.list().size() == 3);
         return true;
     }
 
     bool testOrderPreservation(void) {
-        __setUp();
+        Sorter sorter;
         const char* input[] = {"5", "3", "1", NULL};
-        bool result = initInternals(input);
+        bool result = sorter.load(input);
         __myAssert(result == true);
-        __myAssert(_nsInternalV[0] == 5);
-        __myAssert(_nsInternalV[1] == 3);
-        __myAssert(_nsInternalV[2] == 1);
+        __myAssert(sorter.values()[0] == 5);
+        __myAssert(sorter.values()[1] == 3);
+        __myAssert(sorter.values()[2] == 1);
         
-        IntVector listValues(_nsInternalL.begin(), _nsInternalL.end());
+        IntVector listValues(sorter.list().begin(), sorter.list().end());
         __myAssert(listValues[0] == 5);
         __myAssert(listValues[1] == 3);
         __myAssert(listValues[2] == 1);
-        __tearDown();
         return true;
     }
 
     bool testMixedValidInvalid(void) {
-        __setUp();
+        Sorter sorter;
         const char* input[] = {"1", "abc", "3", "-4", "5", NULL};
-        bool result = initInternals(input);
+        bool result = sorter.load(input);
         __myAssert(result == false);
-        __myAssert(_nsInternalV.size() == 1);
-        __myAssert(_nsInternalL.size() == 1);
-        __tearDown();
+        __myAssert(sorter.values().size() == 1);
+        __myAssert(sorter.list().size() == 1);
+        return true;
+    }
+
+    // Feeds `count` values spaced `stride` apart, plus a repeat of the first
+    // one when `withDuplicate` is set.
+    bool __initSequence(Sorter &sorter, size_t count, int stride, bool withDuplicate) {
+        std::vector<std::string> tokens;
+        std::vector<const char*> input;
+
+        for (size_t i = 0; i < count; ++i) {
+            std::ostringstream oss;
+            oss << (static_cast<int>(count - i) * stride);
+            tokens.push_back(oss.str());
+        }
+        if (withDuplicate)
+            tokens.push_back(tokens.front());
+        for (size_t i = 0; i < tokens.size(); ++i)
+            input.push_back(tokens[i].c_str());
+        input.push_back(NULL);
+
+        return sorter.load(&input[0]);
+    }
+
+    bool testManyUniqueValues(void) {
+        Sorter sorter;
+        __myAssert(__initSequence(sorter, 100000, 1, false) == true); // dense: bitmap
+        __myAssert(sorter.values().size() == 100000);
+
+        sorter.clear();
+        __myAssert(__initSequence(sorter, 100000, 20000, false) == true); // sparse: hash table
+        __myAssert(sorter.values().size() == 100000);
+        return true;
+    }
+
+    bool testManyValuesWithDuplicate(void) {
+        Sorter sorter;
+        __myAssert(__initSequence(sorter, 50000, 3, true) == false);
+        __myAssert(sorter.values().size() == 50000);
+
+        sorter.clear();
+        __myAssert(__initSequence(sorter, 50000, 40000, true) == false);
+        __myAssert(sorter.values().size() == 50000);
+        return true;
+    }
+
+    // Writes `bytes` to a fresh temporary file; returns its path.
+    std::string __writeTempFile(std::string const &bytes) {
+        char path[] = "/tmp/pmergeme_test_XXXXXX";
+        int fd = mkstemp(path);
+        __myAssert(fd >= 0);
+        __myAssert(write(fd, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size()));
+        close(fd);
+        return path;
+    }
+
+    bool testTextFileInput(void) {
+        Sorter sorter;
+        std::string path = __writeTempFile("5 3\n\t1   42\n7\n");
+        __myAssert(sorter.loadFile(path.c_str(), TEXT_INPUT) == true);
+        __myAssert(sorter.values().size() == 5);
+        __myAssert(sorter.values()[3] == 42);
+        __myAssert(sorter.list().size() == 5);
+        std::remove(path.c_str());
+
+        sorter.clear();
+        path = __writeTempFile("5 3 x1 7");
+        __myAssert(sorter.loadFile(path.c_str(), TEXT_INPUT) == false);
+        __myAssert(sorter.values().size() == 2);
+        std::remove(path.c_str());
+        return true;
+    }
+
+    bool testBinaryFileInput(void) {
+        const unsigned char valid[] = { 5, 0, 0, 0,  1, 1, 0, 0,  0xFF, 0xFF, 0xFF, 0x7F };
+        const unsigned char duplicate[] = { 5, 0, 0, 0,  9, 0, 0, 0,  5, 0, 0, 0 };
+        const unsigned char truncated[] = { 5, 0, 0, 0,  9, 0 };
+
+        Sorter sorter;
+        std::string path = __writeTempFile(std::string(reinterpret_cast<const char *>(valid), sizeof(valid)));
+        __myAssert(sorter.loadFile(path.c_str(), BINARY_INPUT) == true);
+        __myAssert(sorter.values().size() == 3);
+        __myAssert(sorter.values()[1] == 257);
+        __myAssert(sorter.values()[2] == INT_MAX);
+        std::remove(path.c_str());
+
+        sorter.clear();
+        path = __writeTempFile(std::string(reinterpret_cast<const char *>(duplicate), sizeof(duplicate)));
+        __myAssert(sorter.loadFile(path.c_str(), BINARY_INPUT) == false);
+        __myAssert(sorter.values().size() == 2);
+        std::remove(path.c_str());
+
+        sorter.clear();
+        path = __writeTempFile(std::string(reinterpret_cast<const char *>(truncated), sizeof(truncated)));
+        __myAssert(sorter.loadFile(path.c_str(), BINARY_INPUT) == false);
+        std::remove(path.c_str());
+        return true;
+    }
+
+    // Random-position inserts against a std::vector doing the same.
+    bool testIndexedSkipList(void) {
+        IndexedSkipList<int> lst;
+        std::vector<int> ref;
+        uint32_t seed = 12345;
+
+        for (int round = 0; round < 2; ++round) { // the second refills recycled nodes
+            lst.clear();
+            ref.clear();
+            for (int i = 0; i < 5000; ++i) {
+                seed = seed * 1103515245U + 12345U;
+                size_t pos = (seed >> 8) % (ref.size() + 1);
+                lst.insert(pos, i);
+                ref.insert(ref.begin() + pos, i);
+            }
+            __myAssert(lst.size() == ref.size());
+            for (size_t i = 0; i < ref.size(); ++i)
+                __myAssert(lst.at(i) == ref[i]);
+            __myAssert(std::equal(ref.begin(), ref.end(), lst.begin()));
+        }
+
+        lst.clear();
+        __myAssert(lst.empty() && lst.begin() == lst.end());
+        lst.push_back(7);
+        __myAssert(lst.size() == 1 && lst.at(0) == 7);
+        return true;
+    }
+
+    // Same exercise for the blocked vector; 5000 elements split many blocks.
+    bool testBlockedVector(void) {
+        BlockedVector<int> vec;
+        std::vector<int> ref;
+        std::vector<int> flat;
+        uint32_t seed = 54321;
+
+        for (int round = 0; round < 2; ++round) { // the second refills recycled blocks
+            vec.clear();
+            ref.clear();
+            for (int i = 0; i < 5000; ++i) {
+                seed = seed * 1103515245U + 12345U;
+                size_t pos = (seed >> 8) % (ref.size() + 1);
+                vec.insert(pos, i);
+                ref.insert(ref.begin() + pos, i);
+            }
+            __myAssert(vec.size() == ref.size());
+            for (size_t i = 0; i < ref.size(); ++i)
+                __myAssert(vec.at(i) == ref[i]);
+            vec.flatten(flat);
+            __myAssert(flat == ref);
+            __myAssert(std::equal(ref.begin(), ref.end(), vec.begin()));
+        }
+
+        vec.clear();
+        __myAssert(vec.empty());
+        vec.push_back(7);
+        __myAssert(vec.size() == 1 && vec.at(0) == 7);
+        return true;
+    }
+
+    struct Record {
+        long long key;
+        int id;
+    };
+
+    struct RecordKeyGreater {
+        bool operator()(Record const &a, Record const &b) const { return a.key > b.key; }
+    };
+
+    // The engine on a non-int record type with a custom comparator, within
+    // Ford-Johnson's worst case of 66 comparisons for 21 elements.
+    bool testGenericSort(void) {
+        std::vector<Record> records(21);
+        size_t comparisons = 0;
+
+        for (size_t i = 0; i < records.size(); ++i) {
+            records[i].key = static_cast<long long>((i * 7919) % 23) << 33;
+            records[i].id = static_cast<int>(i);
+        }
+        fordJohnsonSort(records.begin(), records.end(), RecordKeyGreater(), ComparisonCount(comparisons));
+        for (size_t i = 1; i < records.size(); ++i)
+            __myAssert(records[i - 1].key >= records[i].key);
+        __myAssert(comparisons > 0 && comparisons <= 66);
+
+        std::vector<double> reals;
+        for (int i = 0; i < 100; ++i)
+            reals.push_back((i * 37 % 100) / 4.0);
+        fordJohnsonSort(reals.begin(), reals.end());
+        for (size_t i = 1; i < reals.size(); ++i)
+            __myAssert(reals[i - 1] <= reals[i]);
+
+        std::list<std::string> words;
+        const char *names[] = { "pear", "fig", "apple", "kiwi", "date", "lime", "plum" };
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+            words.push_back(names[i]);
+        const std::string *firstNode = &words.front();
+        fordJohnsonSortList(words, std::less<std::string>(), NoComparisonCount());
+        __myAssert(words.front() == "apple" && words.back() == "plum");
+        for (std::list<std::string>::const_iterator it = words.begin(); it != words.end(); ++it) {
+            if (*it == "pear")
+                __myAssert(&*it == firstNode); // spliced, not copied
+        }
+        return true;
+    }
+
+    // Payload that counts how often it is copied.
+    struct Payload {
+        static size_t copies;
+        int tag;
+        char bulk[256];
+
+        Payload() : tag(0) {}
+        Payload(const Payload &other) : tag(other.tag) { ++copies; }
+        Payload &operator=(const Payload &rhs) { tag = rhs.tag; ++copies; return *this; }
+    };
+    size_t Payload::copies = 0;
+
+    // Key plus payload and indirect sorts: payloads follow their keys and
+    // are each moved about once, and an index subset sorts against shared keys.
+    bool testKeyPayloadSort(void) {
+        std::vector<int> keys;
+        std::vector<Payload> payloads(1000);
+        for (int i = 0; i < 1000; ++i) {
+            keys.push_back((i * 7919) % 1000);
+            payloads[i].tag = keys.back();
+        }
+        Payload::copies = 0;
+        fordJohnsonSortByKey(keys.begin(), keys.end(), payloads.begin(), std::less<int>(), NoComparisonCount());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            __myAssert(keys[i] == static_cast<int>(i));
+            __myAssert(payloads[i].tag == keys[i]);
+        }
+        __myAssert(Payload::copies <= 3 * payloads.size() / 2);
+
+        const int shared[] = { 50, 10, 40, 30, 20 };
+        std::vector<size_t> subset;
+        subset.push_back(0);
+        subset.push_back(2);
+        subset.push_back(4);
+        fordJohnsonSortIndices(subset.begin(), subset.end(), shared, std::less<int>(), NoComparisonCount());
+        __myAssert(subset[0] == 4 && subset[1] == 2 && subset[2] == 0);
+        __myAssert(shared[0] == 50); // keys untouched
+        return true;
+    }
+
+    // Parallel mode must sort like the sequential one and stay within 2% of
+    // its comparisons.
+    bool testParallelSort(void) {
+        std::vector<int> seq;
+        uint32_t seed = 777;
+        for (int i = 0; i < 100000; ++i) {
+            seed = seed * 1103515245U + 12345U;
+            seq.push_back(static_cast<int>(seed >> 4) % 50000); // with duplicates
+        }
+        std::vector<int> par(seq);
+        std::vector<int> ref(seq);
+        size_t seqComparisons = 0;
+        size_t parComparisons = 0;
+        ThreadPool pool(4);
+
+        std::sort(ref.begin(), ref.end());
+        fordJohnsonSort(seq.begin(), seq.end(), std::less<int>(), ComparisonCount(seqComparisons));
+        fordJohnsonSort(par.begin(), par.end(), std::less<int>(), ComparisonCount(parComparisons), &pool);
+        __myAssert(seq == ref);
+        __myAssert(par == ref);
+        __myAssert(parComparisons * 50 <= seqComparisons * 51);
+        return true;
+    }
+
+    // The adapter counts what ComparisonCount counts and times the
+    // comparator it wraps.
+    bool testInstrumentedCompare(void) {
+        std::vector<int> plain;
+        for (int i = 0; i < 500; ++i)
+            plain.push_back((i * 7919) % 500);
+        std::vector<int> wrapped(plain);
+        size_t counted = 0;
+        ComparisonStats stats;
+
+        fordJohnsonSort(plain.begin(), plain.end(), std::less<int>(), ComparisonCount(counted));
+        fordJohnsonSort(wrapped.begin(), wrapped.end(),
+                        InstrumentedCompare<std::less<int> >(std::less<int>(), stats), NoComparisonCount());
+        __myAssert(wrapped == plain);
+        __myAssert(stats.calls == counted);
+        return true;
+    }
+
+    // Inputs many times the memory budget, in both formats: enough runs
+    // that the merge takes several passes, then duplicate and negative
+    // values that only the out-of-core path gets to see.
+    bool testExternalSort(void) {
+        const size_t n = 200000;
+        Sorter sorter;
+        std::string bytes;
+        std::string text;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t value = static_cast<uint32_t>((i * 7919) % n); // a permutation of [0, n)
+            for (int b = 0; b < 4; ++b)
+                bytes.push_back(static_cast<char>(value >> (8 * b)));
+            if (i < n / 4) {
+                std::ostringstream token;
+                token << (i * 7919) % (n / 4) * 3 << (i % 7 ? ' ' : '\n');
+                text += token.str();
+            }
+        }
+        __myAssert(bytes.size() >= 8 * EXTERNAL_MIN_BUDGET);
+        char outPath[] = "/tmp/pmergeme_test_XXXXXX";
+        int outFd = mkstemp(outPath);
+        __myAssert(outFd >= 0);
+        close(outFd);
+
+        std::string path = __writeTempFile(bytes);
+        __myAssert(sorter.sortFile(path.c_str(), BINARY_INPUT, outPath, EXTERNAL_MIN_BUDGET) == true);
+        __myAssert(sorter.stats().externalCount == n);
+        __myAssert(sorter.stats().externalPasses > 1);
+        MappedFile out;
+        __myAssert(out.open(outPath) && out.size() == bytes.size());
+        for (size_t i = 0; i < n; ++i) {
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(out.data()) + 4 * i;
+            __myAssert((p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24) == i);
+        }
+        out.close();
+        std::remove(path.c_str());
+
+        path = __writeTempFile(text);
+        __myAssert(sorter.sortFile(path.c_str(), TEXT_INPUT, outPath, EXTERNAL_MIN_BUDGET) == true);
+        __myAssert(sorter.stats().externalRuns > 1);
+        __myAssert(out.open(outPath));
+        std::istringstream sorted(std::string(out.data(), out.size()));
+        size_t count = 0;
+        for (int value; sorted >> value; ++count)
+            __myAssert(static_cast<size_t>(value) == 3 * count);
+        __myAssert(count == n / 4);
+        out.close();
+        std::remove(path.c_str());
+
+        path = __writeTempFile(text + " 300");
+        __myAssert(sorter.sortFile(path.c_str(), TEXT_INPUT, outPath, EXTERNAL_MIN_BUDGET) == false);
+        std::remove(path.c_str());
+        path = __writeTempFile(text + " -4");
+        __myAssert(sorter.sortFile(path.c_str(), TEXT_INPUT, outPath, EXTERNAL_MIN_BUDGET) == false);
+        std::remove(path.c_str());
+        __myAssert(sorter.sortFile(path.c_str(), TEXT_INPUT, outPath, EXTERNAL_MIN_BUDGET - 1) == false);
+        std::remove(outPath);
+        return true;
+    }
+
+    // Spins ~1 us per call, like a comparator worth saving calls on.
+    struct SlowLess {
+        bool operator()(int a, int b) const {
+            uint64_t until = Perf::nowNs() + 1000;
+            while (Perf::nowNs() < until)
+                ;
+            return a < b;
+        }
+    };
+
+    // The radix sort against std::sort, including one- and no-pass digit
+    // patterns; the strategy picks that the sampled costs call for; and every
+    // strategy through Sorter::sortV.
+    bool testSortStrategy(void) {
+        std::vector<int> values;
+        uint32_t seed = 4242;
+        for (int i = 0; i < 10000; ++i) {
+            seed = seed * 1103515245U + 12345U;
+            values.push_back(static_cast<int>(seed & 0x7FFFFFFF));
+        }
+        values.push_back(0);
+        values.push_back(INT_MAX);
+        std::vector<int> ref(values);
+        std::sort(ref.begin(), ref.end());
+        radixSortNonNegative(values);
+        __myAssert(values == ref);
+
+        std::vector<int> narrow;
+        for (int i = 0; i < 3000; ++i)
+            narrow.push_back((i * 7919) % 2000);
+        ref = narrow;
+        std::sort(ref.begin(), ref.end());
+        radixSortNonNegative(narrow);
+        __myAssert(narrow == ref);
+        std::vector<int> same(100, 7);
+        radixSortNonNegative(same);
+        __myAssert(same == std::vector<int>(100, 7));
+
+        __myAssert(chooseSortStrategy(values.begin(), values.end(), std::less<int>(), true).strategy == STRATEGY_RADIX);
+        __myAssert(chooseSortStrategy(values.begin(), values.end(), std::less<int>(), false).strategy == STRATEGY_INTROSORT);
+        __myAssert(chooseSortStrategy(values.begin(), values.begin() + 10, std::less<int>(), true).strategy == STRATEGY_INTROSORT);
+        StrategyChoice slow = chooseSortStrategy(values.begin(), values.begin() + 2000, SlowLess(), true);
+        __myAssert(slow.strategy == STRATEGY_MERGE_INSERTION && slow.compareNs >= 1000);
+
+        Sorter sorter; // reused: clear() keeps its buffers
+        IntVector shuffled;
+        for (int i = 0; i < 5000; ++i)
+            shuffled.push_back((i * 7919) % 5000);
+        for (int strategy = STRATEGY_AUTO; strategy <= STRATEGY_INTROSORT; ++strategy) {
+            sorter.clear();
+            __myAssert(sorter.load(shuffled) == true);
+            sorter.setStrategy(static_cast<e_sort_strategy>(strategy));
+            sorter.sortV();
+            for (int i = 0; i < 5000; ++i)
+                __myAssert(sorter.values()[i] == i);
+            __myAssert(strategy == STRATEGY_AUTO || sorter.stats().choiceV.strategy == strategy);
+        }
+        return true;
+    }
+
+    // The unrolled base case at every size it covers: all permutations up
+    // to 8 elements and a spread of them above, each sorted within
+    // merge-insertion's worst-case bound, which some input reaches.
+    bool testSmallBaseCase(void) {
+        const size_t bounds[] = { 0, 0, 1, 3, 5, 7, 10, 13, 16, 19, 22, 26, 30, 34, 38, 42, 46 };
+        uint32_t seed = 2024;
+
+        for (int n = 2; n <= FJ_SMALL_MAX; ++n) {
+            std::vector<int> perm;
+            for (int i = 0; i < n; ++i)
+                perm.push_back(i);
+            size_t worst = 0;
+            for (int trial = 0; trial < 20000; ++trial) {
+                if (n <= 8) {
+                    if (trial > 0 && !std::next_permutation(perm.begin(), perm.end()))
+                        break;
+                } else {
+                    for (int i = n - 1; i > 0; --i) {
+                        seed = seed * 1103515245U + 12345U;
+                        std::swap(perm[i], perm[(seed >> 8) % (i + 1)]);
+                    }
+                }
+                std::vector<int> values(perm);
+                size_t comparisons = 0;
+                fordJohnsonSort(values.begin(), values.end(), std::less<int>(), ComparisonCount(comparisons));
+                for (int i = 0; i < n; ++i)
+                    __myAssert(values[i] == i);
+                worst = std::max(worst, comparisons);
+            }
+            __myAssert(worst <= bounds[n]);
+            __myAssert(n > 8 || worst == bounds[n]);
+        }
+        return true;
+    }
+
+    // The JSON export, and in profiling builds what the hooks record: every
+    // comparison charged to exactly one level and phase, each level sorting
+    // the winners of the one above, and large groups going to the batch
+    // phase in parallel mode.
+    bool testFordJohnsonProfile(void) {
+        FordJohnsonProfile profile;
+        std::ostringstream empty;
+        Perf::JsonWriter emptyJson(empty);
+        profile.writeJson(emptyJson);
+        __myAssert(empty.str() == "{\"sorts\": 0, \"comparisons\": 0, \"levels\": []}\n");
+
+        const int n = 50000;
+        std::vector<int> values;
+        for (int i = 0; i < n; ++i)
+            values.push_back((i * 7919) % n);
+        size_t counted = 0;
+        FordJohnsonWorkspace<BlockedVector<size_t> > ws;
+        std::vector<size_t> order;
+        ThreadPool pool(4);
+        ws.profile = &profile;
+        fordJohnsonSort(values.begin(), values.end(), std::less<int>(), ComparisonCount(counted), ws, order, &pool);
+        for (int i = 0; i < n; ++i)
+            __myAssert(values[i] == i);
+
+#if defined(_PMM_PROFILE)
+        std::vector<FordJohnsonLevelStats> const &levels = profile.levels();
+        size_t charged = 0;
+        size_t expected = n;
+        for (size_t d = 0; d < levels.size(); ++d, expected /= 2) {
+            __myAssert(levels[d].elements == expected);
+            if (expected > FJ_SMALL_MAX)
+                __myAssert(levels[d].phases[FJ_PHASE_PAIRING].comparisons == expected / 2);
+            else
+                __myAssert(levels[d].phases[FJ_PHASE_BASE].elements == expected);
+            for (int p = 0; p < FJ_PHASE_COUNT; ++p)
+                charged += levels[d].phases[p].comparisons;
+        }
+        __myAssert(expected <= FJ_SMALL_MAX / 2); // the base case sorts the levels below it
+        __myAssert(profile.sorts() == 1);
+        __myAssert(profile.comparisons() == counted);
+        __myAssert(charged == counted);
+        __myAssert(levels[0].phases[FJ_PHASE_BATCH].elements > 0);
+
+        std::ostringstream json;
+        Perf::JsonWriter writer(json);
+        profile.writeJson(writer);
+        __myAssert(json.str().find("\"batch\": {\"elements\": ") != std::string::npos);
+#else
+        __myAssert(profile.sorts() == 0 && profile.levels().empty());
+#endif
+        return true;
+    }
+
+    namespace {
+        // One Sorter per job; `sorted` is checked by the thread that made
+        // the jobs, since __myAssert throws.
+        struct SorterJob {
+            Sorter *sorter;
+            IntVector input;
+            bool sorted;
+        };
+
+        void __runSorterJob(SorterJob &job) {
+            job.sorted = job.sorter->load(job.input);
+            job.sorter->sort();
+            IntVector ref(job.input);
+            std::sort(ref.begin(), ref.end());
+            job.sorted = job.sorted && job.sorter->values() == ref
+                         && IntList(ref.begin(), ref.end()) == job.sorter->list();
+        }
+
+        void *__sorterThreadMain(void *job) {
+            __runSorterJob(*static_cast<SorterJob *>(job));
+            return NULL;
+        }
+
+        void __sorterRangeTask(void *jobs, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                __runSorterJob(static_cast<SorterJob *>(jobs)[i]);
+        }
+    }
+
+    // Sorters on several threads share one pool, first from threads of their
+    // own and then from inside the pool's own parallelFor, where each sort's
+    // parallel phases nest in the outer job. Inputs are large enough for
+    // parallel mode.
+    bool testConcurrentSorters(void) {
+        enum { JOBS = 4, ELEMENTS = 40000 };
+        ThreadPool pool(4);
+        Sorter sorters[JOBS];
+        SorterJob jobs[JOBS];
+        for (int j = 0; j < JOBS; ++j) {
+            sorters[j].setPool(&pool);
+            sorters[j].setStrategy(STRATEGY_MERGE_INSERTION);
+            jobs[j].sorter = &sorters[j];
+            for (int i = 0; i < ELEMENTS; ++i)
+                jobs[j].input.push_back((i * (7919 + 4 * j)) % ELEMENTS);
+        }
+
+        pthread_t threads[JOBS];
+        bool started[JOBS];
+        for (int j = 0; j < JOBS; ++j)
+            started[j] = pthread_create(&threads[j], NULL, &__sorterThreadMain, &jobs[j]) == 0;
+        for (int j = 0; j < JOBS; ++j) {
+            if (started[j])
+                pthread_join(threads[j], NULL);
+            else
+                __runSorterJob(jobs[j]);
+            __myAssert(jobs[j].sorted);
+        }
+
+        for (int j = 0; j < JOBS; ++j) {
+            sorters[j].clear();
+            std::reverse(jobs[j].input.begin(), jobs[j].input.end());
+        }
+        pool.parallelFor(JOBS, &__sorterRangeTask, jobs);
+        for (int j = 0; j < JOBS; ++j)
+            __myAssert(jobs[j].sorted);
+        return true;
+    }
+
+    struct RecordKeyEqual {
+        bool operator()(Record const &a, Record const &b) const { return a.key == b.key; }
+    };
+
+    // Stable sorts with duplicates: equal keys keep their input order, a
+    // long run of them costs one insertion, and KeySorter takes the full
+    // range of both 64-bit key types from arguments and binary files.
+    bool testStableKeySort(void) {
+        std::vector<Record> records;
+        for (int run = 0; run < 100; ++run) {
+            for (int i = 0; i < 100; ++i) {
+                Record record = { static_cast<long long>((run * 37) % 50) << 40, run * 100 + i };
+                records.push_back(record);
+            }
+        }
+        size_t comparisons = 0;
+        size_t runs = fordJohnsonStableSort(records.begin(), records.end(), RecordKeyGreater(), RecordKeyEqual(),
+                                            ComparisonCount(comparisons));
+        __myAssert(runs == 100);
+        __myAssert(comparisons <= 534); // merge-insertion's worst case for 100 elements
+        for (size_t i = 1; i < records.size(); ++i) {
+            __myAssert(records[i - 1].key >= records[i].key);
+            __myAssert(records[i - 1].key != records[i].key || records[i - 1].id < records[i].id);
+        }
+
+        KeySorter signedKeys(SIGNED_KEYS);
+        const char *input[] = { "5", "-3", "5", "9223372036854775807", "-9223372036854775808", "-3", "0", NULL };
+        const long long expected[] = { -9223372036854775807LL - 1, -3, -3, 0, 5, 5, 9223372036854775807LL };
+        const size_t positions[] = { 4, 1, 5, 6, 0, 2, 3 };
+        __myAssert(signedKeys.load(input) == true);
+        signedKeys.sort();
+        __myAssert(signedKeys.stats().runs == 7);
+        for (size_t i = 0; i < 7; ++i) {
+            __myAssert(static_cast<int64_t>(signedKeys.at(i)) == expected[i]);
+            __myAssert(signedKeys.position(i) == positions[i]);
+        }
+
+        const char *overflow[] = { "1", "9223372036854775808", NULL };
+        signedKeys.clear();
+        __myAssert(signedKeys.load(overflow) == false);
+
+        KeySorter unsignedKeys(UNSIGNED_KEYS);
+        const char *negative[] = { "1", "-1", NULL };
+        __myAssert(unsignedKeys.load(negative) == false);
+        unsignedKeys.clear();
+
+        const unsigned char binary[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                         7, 0, 0, 0, 0, 0, 0, 0,
+                                         7, 0, 0, 0, 0, 0, 0, 0,
+                                         1, 0, 0, 0, 0, 0, 0, 0 };
+        std::string path = __writeTempFile(std::string(reinterpret_cast<const char *>(binary), sizeof(binary)));
+        __myAssert(unsignedKeys.loadFile(path.c_str(), BINARY_INPUT) == true);
+        std::remove(path.c_str());
+        unsignedKeys.sort();
+        __myAssert(unsignedKeys.stats().runs == 3);
+        __myAssert(unsignedKeys.at(0) == 1 && unsignedKeys.at(1) == 7 && unsignedKeys.at(2) == 7);
+        __myAssert(unsignedKeys.at(3) == ~0ULL);
+        __myAssert(unsignedKeys.position(1) == 1 && unsignedKeys.position(2) == 2);
+
+        path = __writeTempFile(std::string(reinterpret_cast<const char *>(binary), 12));
+        unsignedKeys.clear();
+        __myAssert(unsignedKeys.loadFile(path.c_str(), BINARY_INPUT) == false);
+        std::remove(path.c_str());
+        return true;
+    }
+
+    // The shared perf harness: histogram buckets bracket every value to
+    // within 1/SUB_BUCKETS, histogram percentiles stay inside that error,
+    // Samples percentiles are exact, and the JSON writer's separators,
+    // escapes and harness types.
+    bool testPerfHarness(void) {
+        const uint64_t samples[] = { 0, 7, 8, 15, 16, 1000, 123456789, 1ULL << 40, ~0ULL };
+        for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i) {
+            uint64_t v = samples[i];
+            size_t bucket = Perf::Histogram::bucketOf(v);
+            __myAssert(bucket < Perf::Histogram::BUCKETS);
+            __myAssert(Perf::Histogram::bucketUpper(bucket) >= v);
+            __myAssert(bucket == 0 || Perf::Histogram::bucketUpper(bucket - 1) < v);
+            __myAssert(Perf::Histogram::bucketUpper(bucket) - v <= v / Perf::Histogram::SUB_BUCKETS);
+        }
+
+        Perf::Histogram histogram;
+        for (uint64_t v = 1000; v >= 1; --v)
+            histogram.record(v);
+        __myAssert(histogram.count() == 1000 && histogram.min() == 1 && histogram.max() == 1000);
+        __myAssert(histogram.mean() == 500.5);
+        const double quantiles[] = { 0.0, 0.01, 0.5, 0.9, 0.99, 1.0 };
+        for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); ++i) {
+            uint64_t exact = static_cast<uint64_t>(std::ceil(quantiles[i] * 1000));
+            exact = exact ? exact : 1;
+            uint64_t estimate = histogram.percentile(quantiles[i]);
+            __myAssert(estimate >= exact && estimate <= exact + exact / Perf::Histogram::SUB_BUCKETS);
+        }
+        histogram.clear();
+        __myAssert(histogram.count() == 0 && histogram.percentile(0.5) == 0 && histogram.min() == 0);
+
+        Perf::Samples latency;
+        for (uint64_t v = 1000; v >= 1; --v)
+            latency.record(v);
+        __myAssert(latency.count() == 1000 && latency.min() == 1 && latency.max() == 1000);
+        __myAssert(latency.mean() == 500.5);
+        __myAssert(latency.percentile(0.0) == 1 && latency.percentile(0.01) == 10);
+        __myAssert(latency.percentile(0.5) == 500 && latency.percentile(0.99) == 990);
+        __myAssert(latency.percentile(1.0) == 1000);
+        latency.record(0);
+        __myAssert(latency.percentile(0.0) == 0 && latency.histogram().count() == 1001);
+        latency.clear();
+        __myAssert(latency.count() == 0 && latency.percentile(0.5) == 0);
+        latency.record(9);
+        latency.record(3);
+        std::ostringstream samplesOut;
+        Perf::JsonWriter(samplesOut).value(latency);
+        __myAssert(samplesOut.str() == "{\"count\": 2, \"min\": 3, \"max\": 9, \"mean\": 6, \"p50\": 3, "
+                                       "\"p90\": 9, \"p99\": 9, \"p999\": 9, \"buckets\": [[3, 1], [9, 1]]}\n");
+
+        const char *names[] = { "hits", "misses" };
+        Perf::Counters counters(names, 2);
+        Perf::PhaseTimes phases(names, 2);
+        counters.add(0, 3);
+        phases.add(1, 40);
+        {
+            Perf::ScopedPhase scoped(phases, 0);
+        }
+        __myAssert(phases.entries(0) == 1 && phases.entries(1) == 1 && phases.totalNs(1) == 40);
+
+        std::ostringstream out;
+        Perf::JsonWriter json(out);
+        json.beginObject();
+        json.field("counters", counters);
+        json.key("list").beginArray().value(1).value(2.5).value(true).value(0.0 / 0.0).endArray();
+        json.field("text", "a\"b\n");
+        json.endObject();
+        __myAssert(out.str() == "{\"counters\": {\"hits\": 3, \"misses\": 0}, "
+                                "\"list\": [1, 2.5, true, null], \"text\": \"a\\\"b\\u000a\"}\n");
         return true;
     }
 
@@ -197,6 +1357,23 @@ namespace PmergeMe {
             allPassed &= testLargeNumbers();
             allPassed &= testOrderPreservation();
             allPassed &= testMixedValidInvalid();
+            allPassed &= testManyUniqueValues();
+            allPassed &= testManyValuesWithDuplicate();
+            allPassed &= testTextFileInput();
+            allPassed &= testBinaryFileInput();
+            allPassed &= testIndexedSkipList();
+            allPassed &= testBlockedVector();
+            allPassed &= testGenericSort();
+            allPassed &= testKeyPayloadSort();
+            allPassed &= testParallelSort();
+            allPassed &= testInstrumentedCompare();
+            allPassed &= testExternalSort();
+            allPassed &= testSortStrategy();
+            allPassed &= testSmallBaseCase();
+            allPassed &= testFordJohnsonProfile();
+            allPassed &= testConcurrentSorters();
+            allPassed &= testStableKeySort();
+            allPassed &= testPerfHarness();
         } catch (const std::exception& e) {
             ERRLOG("Test failed with exception: " << e.what()) __ERRFLUSH();
             return false;
@@ -205,359 +1382,397 @@ namespace PmergeMe {
         return allPassed;
     }
 
-    // template <typename T>
-    // void __mergeInsertionGeneric(T& c, int depth);
+    SortStats::SortStats()
+        : comparisonsV(0), comparisonsL(0), comparisonsExternal(0), elapsedNsV(0), elapsedNsL(0),
+          externalCount(0), externalRuns(0), externalPasses(0), elapsedNsExternal(0) {
+        StrategyChoice none = { STRATEGY_AUTO, "not sorted yet", 0 };
+        choiceV = none;
+    }
 
-    void printInternalV(void) _PMM_NOEXCEPT {
-        IntVector::const_iterator it = _nsInternalV.begin();
+    struct Sorter::ContainerSink {
+        Sorter *sorter;
 
-        for (IntVector::const_iterator i = it; i != _nsInternalV.end(); ++i) {
-            PRINT(*i << (i + 1 == _nsInternalV.end() ? "" : " "));
-        } __FLUSH();
+        void prepare(size_t count) { sorter->prepareIngest_impl(count); }
+        bool push(int value, int &errorCode) { return sorter->push_impl(value, errorCode); }
+    };
+
+    Sorter::Sorter(ThreadPool *pool)
+        : _v(), _l(), _seen(), _pool(pool), _strategy(_nsInternalDefaultStrategy), _stats(),
+          _workspaceV(), _workspaceL(), _order(), _nodes(), _profileV(), _profileL() {
+        _workspaceV.profile = &_profileV;
+        _workspaceL.profile = &_profileL;
     }
 
-    void printInternalL(void) _PMM_NOEXCEPT {
-        IntList::const_iterator it = _nsInternalL.begin();
+    void Sorter::setPool(ThreadPool *pool) {
+        _pool = pool;
+    }
 
-        for (IntList::const_iterator i = it; i != _nsInternalL.end(); ++i) {
-            PRINT(*i << (i == _nsInternalL.end() ? "" : " "));
-        } __FLUSH();
+    void Sorter::setStrategy(e_sort_strategy strategy) {
+        _strategy = strategy;
     }
 
-    bool initInternals(const char *numList[]) _PMM_NOEXCEPT {
+    bool Sorter::load(const char *numList[]) _PMM_NOEXCEPT {
+        ContainerSink sink = { this };
         int errorCode = 0;
+        size_t count = 0;
+
+        while (numList[count])
+            ++count;
+        sink.prepare(count);
 
         for (int i = 0; numList[i]; ++i) {
-            std::string token = numList[i];
-            if (!__parsePushValue(token, errorCode)) {
-                switch (errorCode) {
-                    case EMPTY_STRING:
-                        ERRLOG("Warning: Empty string encountered. Moving on...") __ERRFLUSH();
-                        continue;
-                    case INVALID_FOMRAT:
-                        ERRLOG("Error: `" << token << "`: Invalid format.") __ERRFLUSH();
-                        break;
-                    case NEGATIVE_NUMBER:
-                        ERRLOG("Error: `" << token << "`: Only accepting positive integers.") __ERRFLUSH();
-                        break;
-                    case DUPLICATE_VALUE:
-                        ERRLOG("Error: `" << token << "` already exists and is not allowed.") __ERRFLUSH();
-                        break;
-                    default:
-                        ERRLOG("Status: Irrecoverable error encountered.") __ERRFLUSH();
-                }
+            const char *token = numList[i];
+            if (!__parsePushValue(token, token + std::strlen(token), sink, errorCode)) {
+                if (__reportError(errorCode, token))
+                    continue;
                 return false;
             }
         }
 
-        if (_nsInternalV.size() < 2) {
-            ERRLOG("Error: Not enough input elements. Need at least two positive integers.") __ERRFLUSH();
-            return false;
-        }
-        return true;
+        return __checkEnoughElements(_v.size());
     }
 
-    // Binary search in range [low, high) of vec.
-    size_t __binarySearchInsertionPositionInRange(const IntVector& vec, int value, size_t low, size_t high) {
-        size_t l = low, h = high;
-        while (l < h) {
-            size_t mid = (l + h) / 2;
-            if (vec[mid] < value)
-                l = mid + 1;
-            else
-                h = mid;
-            ++_nsInternalCompCount;
+    bool Sorter::load(IntVector const &values) _PMM_NOEXCEPT {
+        int errorCode = 0;
+
+        prepareIngest_impl(values.size());
+        for (IntVector::const_iterator it = values.begin(); it != values.end(); ++it) {
+            if (!push_impl(*it, errorCode)) {
+                std::ostringstream token;
+                token << *it;
+                __reportError(errorCode, token.str());
+                return false;
+            }
         }
-        return l;
+        return __checkEnoughElements(_v.size());
     }
 
-    size_t __binarySearchInsertionPositionInRange(const IntList& lst, int value, size_t low, size_t high) {
-        size_t l = low;
-        size_t h = high;
-        
-        while (l < h) {
-            size_t mid = (l + h) / 2;
-            
-            IntList::const_iterator it = lst.begin();
-            std::advance(it, mid);
-            
-            if (*it < value) {
-                l = mid + 1;
-            } else {
-                h = mid;
-            }
-            ++_nsInternalCompCount;
-        }
-        return l;
-    }
-
-    std::vector<size_t> __generateInsertionOrder(size_t n) {
-        std::vector<size_t> jacobsthal;
-        jacobsthal.push_back(1); // t1 = 1
-        while (true) {
-            size_t k = jacobsthal.size();
-            size_t next;
-            if (k == 1)
-                next = 3; // t2 = 3
-            else
-                next = jacobsthal[k - 1] + 2 * jacobsthal[k - 2];
-            if (next > n)
-                break;
-            jacobsthal.push_back(next);
+    bool Sorter::loadFile(const char *path, e_input_format format) _PMM_NOEXCEPT {
+        MappedFile file;
+        if (!file.open(path)) {
+            ERRLOG("Error: `" << path << "`: could not open file.") __ERRFLUSH();
+            return false;
         }
-        
-        std::vector<size_t> order;
-        size_t current = 2;
-        for (size_t i = 1; i < jacobsthal.size(); ++i) {
-            size_t start = current;
-            size_t end = jacobsthal[i]; // inclusive
-
-            for (size_t j = end; j >= start; --j) {
-                order.push_back(j);
-                if (j == start)
-                    break;
-            }
-            current = jacobsthal[i] + 1;
+
+        ContainerSink sink = { this };
+        const char *data = file.data();
+        const char *end = data + file.size();
+        bool ingested = (format == BINARY_INPUT)
+            ? __ingestBinary(data, end, path, sink)
+            : __ingestText(data, end, sink);
+
+        return ingested && __checkEnoughElements(_v.size());
+    }
+
+    void Sorter::clear(void) {
+        _v.clear();
+        _l.clear();
+        _seen.clear();
+    }
+
+    void Sorter::sort(void) {
+        sortV();
+        sortL();
+    }
+
+    void Sorter::sortV(void) {
+        uint64_t start = Perf::nowNs();
+        _stats.comparisonsV = 0;
+        _profileV.clear();
+        SortCounter count(_stats.comparisonsV);
+        CountedLess less = { &count };
+
+        if (_strategy == STRATEGY_AUTO) {
+            _stats.choiceV = chooseSortStrategy(_v.begin(), _v.end(), std::less<int>(), true);
+        } else {
+            StrategyChoice chosen = { _strategy, "selected explicitly", 0 };
+            _stats.choiceV = chosen;
         }
-        if (current <= n) {
-            for (size_t j = n; j >= current; --j) {
-                order.push_back(j);
-                if (j == current)
-                    break;
-            }
+
+        switch (_stats.choiceV.strategy) {
+            case STRATEGY_RADIX:
+                radixSortNonNegative(_v); // parsing admits no negative values
+                break;
+            case STRATEGY_INTROSORT:
+                std::sort(_v.begin(), _v.end(), less);
+                break;
+            default:
+                fordJohnsonSort(_v.begin(), _v.end(), std::less<int>(), count, _workspaceV, _order, _pool);
+                break;
         }
-        return order;
+
+        _stats.elapsedNsV = Perf::nowNs() - start;
+
+#if defined(_PMM_ASSERT_TEST)
+        PRINT("Vector Comparisons: " << _stats.comparisonsV) __FLUSH();
+#endif
     }
 
-    // 0 1 2 3 4
-    // x y z w a
+    void Sorter::sortL(void) {
+        uint64_t start = Perf::nowNs();
+        _stats.comparisonsL = 0;
+        _profileL.clear();
+
+        fordJohnsonSortList(_l, std::less<int>(), SortCounter(_stats.comparisonsL), _workspaceL, _order, _nodes,
+                            _pool);
 
-    // 0 1 2 3 4    0 1 2 3 4
-    // y z w x a    l o p q r
+        _stats.elapsedNsL = Perf::nowNs() - start;
 
-    IntVector __extractCorrespondingLosers(const IntVector &winners, const IntVector &sortedWinners, const IntVector &losers) {
-        // winners: original winners in pairing order.
-        // sortedWinners: winners sorted recursively.
-        // losers: losers paired with winners (in the same order as winners).
-        IntVector pendChain;
-        pendChain.resize(sortedWinners.size());
+#if defined(_PMM_ASSERT_TEST)
+        PRINT("List Comparisons: " << _stats.comparisonsL) __FLUSH();
+#endif
+    }
 
-        for (size_t i = 0; i < sortedWinners.size(); ++i) {
-            size_t index = std::distance(winners.begin(),
-            std::find(winners.begin(), winners.end(), sortedWinners[i]));
-            pendChain[i] = losers[index];
+    bool Sorter::sortFile(const char *inPath, e_input_format format, const char *outPath, size_t memoryBudget) {
+        if (memoryBudget < EXTERNAL_MIN_BUDGET) {
+            ERRLOG("Error: memory budget must be at least " << EXTERNAL_MIN_BUDGET << " bytes.") __ERRFLUSH();
+            return false;
         }
+        _stats.comparisonsExternal = 0;
+        _stats.externalCount = 0;
+        _stats.externalRuns = 0;
+        _stats.externalPasses = 0;
 
-        if (losers.size() > winners.size()) {
-            pendChain.push_back(losers.back());
+        uint64_t start = Perf::nowNs();
+        int spill[2] = { openSpillFile(), openSpillFile() };
+        bool ok = spill[0] >= 0 && spill[1] >= 0;
+        if (!ok) {
+            ERRLOG("Error: could not create a spill file.") __ERRFLUSH();
+        } else {
+            ok = __sortFileExternally(inPath, format, outPath, memoryBudget, spill, _stats, _pool);
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (spill[i] >= 0)
+                close(spill[i]);
         }
+        _stats.elapsedNsExternal = Perf::nowNs() - start;
 
 #if defined(_PMM_ASSERT_TEST)
-        for (size_t i = 0; i < sortedWinners.size(); ++i) {
-            __myAssert(sortedWinners[i] >= pendChain[i]);
-        }
+        PRINT("Run Comparisons: " << _stats.comparisonsExternal) __FLUSH();
 #endif
+        return ok;
+    }
 
-        return pendChain;
+    IntVector const &Sorter::values(void) const {
+        return _v;
     }
 
-    IntVector __fordJohnsonSortV(const IntVector& input) {
-        int n = input.size();
-        if (n == 1) return input;
-    
-        IntVector winners;
-        IntVector losers;
-        IntVector partnerValue;
-        
-        for (int i = 0; i + 1 < n; i += 2) {
-            if (input[i] < input[i + 1]) {
-                winners.push_back(input[i + 1]);
-                losers.push_back(input[i]);
-                partnerValue.push_back(input[i + 1]);
-            } else {
-                winners.push_back(input[i]);
-                losers.push_back(input[i + 1]);
-                partnerValue.push_back(input[i]);
-            }
-            ++_nsInternalCompCount;
-        } if (n % 2 != 0) {
-            losers.push_back(input[n - 1]);
+    IntList const &Sorter::list(void) const {
+        return _l;
+    }
+
+    SortStats const &Sorter::stats(void) const {
+        return _stats;
+    }
+
+    FordJohnsonProfile const &Sorter::profileV(void) const {
+        return _profileV;
+    }
+
+    FordJohnsonProfile const &Sorter::profileL(void) const {
+        return _profileL;
+    }
+
+    void Sorter::printV(void) const _PMM_NOEXCEPT {
+        IntVector::const_iterator it = _v.begin();
+
+        for (IntVector::const_iterator i = it; i != _v.end(); ++i) {
+            PRINT(*i << (i + 1 == _v.end() ? "" : " "));
+        } __FLUSH();
+    }
+
+    void Sorter::printL(void) const _PMM_NOEXCEPT {
+        IntList::const_iterator it = _l.begin();
+
+        for (IntList::const_iterator i = it; i != _l.end(); ++i) {
+            PRINT(*i << (i == _l.end() ? "" : " "));
+        } __FLUSH();
+    }
+
+    void Sorter::printTimeV(void) const {
+		PRINT("Time to process a range of " << _v.size() << " elements with std::vector : " << __formatMicros(_stats.elapsedNsV) << ".") __FLUSH();
+    }
+
+    void Sorter::printTimeL(void) const {
+		PRINT("Time to process a range of " << _l.size() << " elements with std::list : " << __formatMicros(_stats.elapsedNsL) << ".") __FLUSH();
+    }
+
+    void Sorter::printTimeExternal(void) const {
+		PRINT("Time to process a range of " << _stats.externalCount << " elements out of core ("
+		      << _stats.externalRuns << " runs, " << _stats.externalPasses << " merge passes) : "
+		      << __formatMicros(_stats.elapsedNsExternal) << ".") __FLUSH();
+    }
+
+    void Sorter::printStrategyV(void) const {
+        PRINT("Strategy for std::vector : " << strategyName(_stats.choiceV.strategy) << " ("
+              << _stats.choiceV.reason);
+        if (_stats.choiceV.compareNs)
+            PRINT("; a comparison took ~" << _stats.choiceV.compareNs << " ns");
+        PRINT(").") __FLUSH();
+    }
+
+    // Grows the containers and the duplicate set for `count` more values.
+    void Sorter::prepareIngest_impl(size_t count) {
+        _seen.reserve(_v.size() + count);
+        _v.reserve(_v.size() + count);
+    }
+
+    bool Sorter::push_impl(int value, int &errorCode) {
+        if (value < 0) {
+            errorCode = NEGATIVE_NUMBER;
+            return false;
         }
-        
-        IntVector sortedWinners = __fordJohnsonSortV(winners);
-        IntVector mainChain = sortedWinners;
-        
-        IntVector pendChain = __extractCorrespondingLosers(winners, sortedWinners, losers);
-    
-        if (!pendChain.empty()) {
-            int firstLoser = pendChain[0];
-
-            mainChain.insert(mainChain.begin(), firstLoser);
-        }
-    
-        size_t pendingCount = pendChain.size();
-        if (pendingCount > 1) {
-            std::vector<size_t> insOrder = __generateInsertionOrder(pendingCount);
-    
-            for (size_t k = 0; k < insOrder.size(); ++k) {
-                size_t idx = insOrder[k] - 1;
-                if (idx == 0) continue;
-                
-                int loserVal = pendChain[idx];
-                int partner = sortedWinners[idx];
-                
-                IntVector::iterator it = std::find(mainChain.begin(), mainChain.end(), partner);
-                size_t partnerPos = it - mainChain.begin();
-                
-                size_t pos = __binarySearchInsertionPositionInRange(mainChain, loserVal, 0, partnerPos);
-                mainChain.insert(mainChain.begin() + pos, loserVal);
-            }
+
+        if (!_seen.insert(value)) {
+            errorCode = DUPLICATE_VALUE;
+            return false;
         }
-        
-        return mainChain;
+
+        _l.push_back(value);
+        _v.push_back(value);
+
+        return true;
     }
 
-    IntList __extractCorrespondingLosers(const IntList& winners, const IntList& sortedWinners, const IntList& losers) {
-        IntList pendChain;
-        
-        for (IntList::const_iterator sortedIt = sortedWinners.begin(); sortedIt != sortedWinners.end(); ++sortedIt) {
-            IntList::const_iterator winnerIt = std::find(winners.begin(), winners.end(), *sortedIt);
-            size_t index = std::distance(winners.begin(), winnerIt);
-            
-            IntList::const_iterator loserIt = losers.begin();
-            std::advance(loserIt, index);
-            pendChain.push_back(*loserIt);
-        }
-    
-        if (losers.size() > winners.size()) {
-            pendChain.push_back(losers.back());
+    KeySortStats::KeySortStats() : comparisons(0), runs(0), elapsedNs(0) {}
+
+    struct KeySorter::KeySink {
+        KeySorter *sorter;
+
+        bool pushToken(const char *begin, const char *end, int &errorCode) {
+            uint64_t ordered;
+            if (!__parseKey(begin, end, sorter->_type, ordered)) {
+                errorCode = INVALID_FOMRAT;
+                return false;
+            }
+            sorter->_positions.push_back(sorter->_keys.size());
+            sorter->_keys.push_back(ordered);
+            return true;
         }
+    };
 
-#if defined(_PMM_ASSERT_TEST)
-        IntList::const_iterator pendIt = pendChain.begin();
-        for (IntList::const_iterator sortedIt2 = sortedWinners.begin(); sortedIt2 != sortedWinners.end(); ++sortedIt2) {
-            __myAssert(*sortedIt2 >= *pendIt);
-            std::advance(pendIt, 1);
-        }
-#endif 
-    
-        return pendChain;
-    }
-    
-    IntList __fordJohnsonSortL(const IntList& input) {
-        size_t n = input.size();
-        if (n == 1)
-            return input;
-    
-        IntList winners;
-        IntList losers;
-        IntList partnerValue;
-        
-        IntList::const_iterator it = input.begin();
-        while (it != input.end() && std::distance(it, input.end()) >= 2) {
-            int first = *it;
-            ++it;
-            int second = *it;
-            ++it;
-            
-            if (first < second) {
-                winners.push_back(second);
-                losers.push_back(first);
-                partnerValue.push_back(second);
-            } else {
-                winners.push_back(first);
-                losers.push_back(second);
-                partnerValue.push_back(first);
-            }
-            ++_nsInternalCompCount;
+    KeySorter::KeySorter(e_key_type type, ThreadPool *pool)
+        : _type(type), _pool(pool), _keys(), _scratch(), _positions(), _order(), _stats(), _workspace() {}
+
+    void KeySorter::setPool(ThreadPool *pool) {
+        _pool = pool;
+    }
+
+    bool KeySorter::load(const char *numList[]) _PMM_NOEXCEPT {
+        KeySink sink = { this };
+        int errorCode = 0;
+
+        for (int i = 0; numList[i]; ++i) {
+            const char *token = numList[i];
+            if (*token == '\0') {
+                __reportError(EMPTY_STRING, token);
+                continue;
+            }
+            if (!sink.pushToken(token, token + std::strlen(token), errorCode)) {
+                __reportError(errorCode, token);
+                return false;
+            }
         }
-        
-        if (it != input.end()) {
-            losers.push_back(*it);
-            partnerValue.push_back(std::numeric_limits<int>::max());
+        return __checkEnoughElements(_keys.size(), "keys");
+    }
+
+    bool KeySorter::loadFile(const char *path, e_input_format format) _PMM_NOEXCEPT {
+        MappedFile file;
+        if (!file.open(path)) {
+            ERRLOG("Error: `" << path << "`: could not open file.") __ERRFLUSH();
+            return false;
         }
-        
-        IntList sortedWinners = __fordJohnsonSortL(winners);
-        IntList mainChain = sortedWinners;
-    
-        IntList pendChain = __extractCorrespondingLosers(winners, sortedWinners, losers);
-        IntList sortedPartners = __extractCorrespondingLosers(winners, sortedWinners, partnerValue);
-    
-        if (!pendChain.empty()) {
-            IntList::const_iterator pendIt = pendChain.begin();
-            int firstLoser = *pendIt;
-
-            mainChain.insert(mainChain.begin(), firstLoser);
-        }
-    
-        size_t pendingCount = pendChain.size();
-        if (pendingCount > 1) {
-            std::vector<size_t> insOrder = __generateInsertionOrder(pendingCount);
-    
-            for (size_t k = 0; k < insOrder.size(); ++k) {
-                size_t idx = insOrder[k] - 1;
-                if (idx == 0)
-                    continue;
-                    
-                IntList::const_iterator pendIt = pendChain.begin();
-                IntList::const_iterator partnerIt = sortedPartners.begin(); ////
-                std::advance(pendIt, idx);
-                std::advance(partnerIt, idx);
-                
-                int loserVal = *pendIt;
-                int partner = *partnerIt;
-    
-                IntList::iterator mainIt = std::find(mainChain.begin(), mainChain.end(), partner);
-                size_t partnerPos = std::distance(mainChain.begin(), mainIt);
-                
-                size_t pos = __binarySearchInsertionPositionInRange(mainChain, loserVal, 0, partnerPos);
-                mainIt = mainChain.begin();
-                std::advance(mainIt, pos);
-                mainChain.insert(mainIt, loserVal);
+
+        const char *data = file.data();
+        const char *end = data + file.size();
+        size_t bytes = file.size();
+        if (format == BINARY_INPUT) {
+            if (!__checkBinarySize(bytes, 8, path))
+                return false;
+            _keys.reserve(_keys.size() + bytes / 8);
+            _positions.reserve(_positions.size() + bytes / 8);
+            for (const char *p = data; p != end; p += 8) {
+                uint64_t raw;
+                std::memcpy(&raw, p, sizeof(raw));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                raw = __builtin_bswap64(raw);
+#endif
+                _positions.push_back(_keys.size());
+                _keys.push_back(_type == SIGNED_KEYS ? raw ^ (1ULL << 63) : raw);
             }
+        } else {
+            size_t count = __countTextTokens(data, end);
+            _keys.reserve(_keys.size() + count);
+            _positions.reserve(_positions.size() + count);
+            KeySink sink = { this };
+            if (!__forEachTextToken(data, end, sink))
+                return false;
         }
+        return __checkEnoughElements(_keys.size(), "keys");
+    }
 
-        return mainChain;
+    void KeySorter::clear(void) {
+        _keys.clear();
+        _positions.clear();
     }
 
+    // The engine sorts a permutation, which then gathers the keys and their
+    // input positions.
+    void KeySorter::sort(void) {
+        uint64_t start = Perf::nowNs();
+        _stats.comparisons = 0;
 
-    void mergeInsertionSortV(void) {
-        clock_t start = clock();
-        
-        IntVector temp = __fordJohnsonSortV(_nsInternalV);
-        
-        clock_t end = clock();
-        _nsInternalElapsedTicksV = end - start;
-        
-        _nsInternalV = temp;
+        _stats.runs = fordJohnsonStableOrderInto(_keys.begin(), _keys.end(), std::less<uint64_t>(),
+                                                 std::equal_to<uint64_t>(), SortCounter(_stats.comparisons),
+                                                 _workspace, _order, _pool);
+        _scratch.resize(_keys.size());
+        for (size_t i = 0; i < _order.size(); ++i) {
+            _scratch[i] = _keys[_order[i]];
+            _order[i] = _positions[_order[i]];
+        }
+        _keys.swap(_scratch);
+        _positions.swap(_order);
+
+        _stats.elapsedNs = Perf::nowNs() - start;
 
 #if defined(_PMM_ASSERT_TEST)
-        PRINT("Vector Comparisons: " << _nsInternalCompCount) __FLUSH();
+        PRINT("Key Comparisons: " << _stats.comparisons) __FLUSH();
 #endif
-        _nsInternalCompCount = 0;
     }
 
-    void mergeInsertionSortL(void) {
-        clock_t start = clock();
-        
-        IntList temp = __fordJohnsonSortL(_nsInternalL);
-        
-        clock_t end = clock();
-        _nsInternalElapsedTicksL = end - start;
-        
-        _nsInternalL = temp;
+    e_key_type KeySorter::type(void) const {
+        return _type;
+    }
 
-#if defined(_PMM_ASSERT_TEST)
-        PRINT("List Comparisons: " << _nsInternalCompCount) __FLUSH();
-#endif
-        _nsInternalCompCount = 0;
-    } 
+    size_t KeySorter::size(void) const {
+        return _keys.size();
+    }
+
+    uint64_t KeySorter::at(size_t i) const {
+        return _type == SIGNED_KEYS ? _keys[i] ^ (1ULL << 63) : _keys[i];
+    }
 
-    void printTimeV(void) {
-		PRINT("Time to process a range of " << _nsInternalV.size() << " elements with std::vector : " << _nsInternalElapsedTicksV << " ticks.") __FLUSH();
+    size_t KeySorter::position(size_t i) const {
+        return _positions[i];
+    }
+
+    KeySortStats const &KeySorter::stats(void) const {
+        return _stats;
+    }
+
+    void KeySorter::print(void) const _PMM_NOEXCEPT {
+        for (size_t i = 0; i < _keys.size(); ++i) {
+            if (_type == SIGNED_KEYS)
+                PRINT(static_cast<long long>(static_cast<int64_t>(at(i))));
+            else
+                PRINT(static_cast<unsigned long long>(at(i)));
+            PRINT((i + 1 == _keys.size() ? "" : " "));
+        } __FLUSH();
     }
 
-    void printTimeL(void) {
-		PRINT("Time to process a range of " << _nsInternalL.size() << " elements with std::list : " << _nsInternalElapsedTicksL << " ticks.") __FLUSH();
+    void KeySorter::printTime(void) const {
+		PRINT("Time to process a range of " << _keys.size() << " " << (_type == SIGNED_KEYS ? "int64" : "uint64")
+		      << " keys (" << _stats.runs << " runs) with stable merge-insertion : "
+		      << __formatMicros(_stats.elapsedNs) << ".") __FLUSH();
     }
-}
\ No newline at end of file
+}
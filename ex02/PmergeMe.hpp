@@ -14,6 +14,10 @@
 #include <vector>
 #include <list>
 #include <algorithm>
+#include <stdint.h>
+#include "SortStrategy.hpp"
+#include "IntSet.hpp"
+#include "FordJohnson.hpp"
 
 #define PRINT(X) std::cout << X
 #define __FLUSH(X) ;std::cout << std::endl
@@ -31,9 +35,171 @@ typedef std::pair<IntVector, IntVector> IntVectorPair;
 #define _PMM_PARSING_ONLY
 
 namespace PmergeMe {
-    bool initInternals(const char *numList[]) _PMM_NOEXCEPT;
-    void printInternalV(void) _PMM_NOEXCEPT;
-    void printInternalL(void) _PMM_NOEXCEPT;
+    enum e_input_format {
+        TEXT_INPUT,     // whitespace-separated decimal integers
+        BINARY_INPUT    // raw little-endian int32
+    };
+
+    enum e_key_type {
+        SIGNED_KEYS,    // int64_t
+        UNSIGNED_KEYS   // uint64_t
+    };
+
+    enum { EXTERNAL_MIN_BUDGET = 1 << 16 };
+
+    // What a Sorter's latest sorts did. Comparisons are only counted in
+    // assert builds.
+    struct SortStats {
+        size_t comparisonsV;
+        size_t comparisonsL;
+        size_t comparisonsExternal; // sorting the runs; merging is not counted
+        uint64_t elapsedNsV;
+        uint64_t elapsedNsL;
+        StrategyChoice choiceV;
+
+        size_t externalCount;
+        size_t externalRuns;
+        size_t externalPasses;
+        uint64_t elapsedNsExternal;
+
+        SortStats();
+    };
+
+    // One sort job: owns its input containers, duplicate check, statistics
+    // and configuration, and shares nothing else, so any number of Sorters
+    // can work at once on different threads. They may share one ThreadPool
+    // for parallel mode. A Sorter can be cleared and loaded again; its
+    // vector, duplicate set and engine scratch keep their capacity.
+    class Sorter {
+    public:
+        explicit Sorter(ThreadPool *pool = NULL);
+
+        // Threads for parallel mode, the caller included; NULL (the default)
+        // keeps the sorts sequential. Parallel mode may report a few more
+        // comparisons.
+        void setPool(ThreadPool *pool);
+        // How sortV() sorts: STRATEGY_AUTO (the default outside assert
+        // builds) samples the input and the comparator and picks the fastest
+        // of merge-insertion, radix and introsort; the others force one.
+        void setStrategy(e_sort_strategy strategy);
+
+        // Appends the values, rejecting negatives and duplicates with a
+        // message on stderr; empty strings are skipped with a warning.
+        bool load(const char *numList[]) _PMM_NOEXCEPT;
+        bool load(IntVector const &values) _PMM_NOEXCEPT;
+        // Memory-maps `path` and parses it in place. Same validation and
+        // error messages as load().
+        bool loadFile(const char *path, e_input_format format) _PMM_NOEXCEPT;
+        void clear(void);
+
+        void sort(void); // sortV() then sortL()
+        void sortV(void);
+        void sortL(void);
+
+        // Out-of-core sort of `inPath`, for inputs larger than memory:
+        // sorted runs of about `memoryBudget` bytes are spilled to temporary
+        // files and then merged, k ways at a time, into `outPath`, written in
+        // the input's format (text gets one value per line). Same validation
+        // and error messages as loadFile(); duplicates are caught while
+        // merging, so `outPath` may be left partly written. The loaded
+        // values are not involved.
+        bool sortFile(const char *inPath, e_input_format format, const char *outPath, size_t memoryBudget);
+
+        IntVector const &values(void) const;
+        IntList const &list(void) const;
+        SortStats const &stats(void) const;
+        // Per-level, per-phase breakdown of the latest merge-insertion
+        // sorts; empty unless built with _PMM_PROFILE (make profile).
+        FordJohnsonProfile const &profileV(void) const;
+        FordJohnsonProfile const &profileL(void) const;
+
+        void printV(void) const _PMM_NOEXCEPT;
+        void printL(void) const _PMM_NOEXCEPT;
+        void printTimeV(void) const;
+        void printTimeL(void) const;
+        void printTimeExternal(void) const;
+        void printStrategyV(void) const;
+
+    private:
+        IntVector _v;
+        IntList _l;
+        IntSet _seen; // values of _v, for duplicate checks
+        ThreadPool *_pool;
+        e_sort_strategy _strategy;
+        SortStats _stats;
+
+        FordJohnsonWorkspace<BlockedVector<size_t> > _workspaceV;
+        FordJohnsonWorkspace<IndexedSkipList<size_t> > _workspaceL;
+        std::vector<size_t> _order;
+        std::vector<IntList::iterator> _nodes;
+        FordJohnsonProfile _profileV;
+        FordJohnsonProfile _profileL;
+
+        struct ContainerSink; // feeds parsed values to push_impl()
+
+        void prepareIngest_impl(size_t count);
+        bool push_impl(int value, int &errorCode);
+
+        Sorter(const Sorter& other);
+        Sorter& operator=(const Sorter& rhs);
+    };
+
+    struct KeySortStats {
+        size_t comparisons; // assert builds only
+        size_t runs;        // runs of equal adjacent keys, each sorted as one
+        uint64_t elapsedNs;
+
+        KeySortStats();
+    };
+
+    // Stable merge-insertion sort of 64-bit keys, such as timestamps or IDs:
+    // duplicates are allowed and equal keys keep their input order, which
+    // position() reports. Adjacent equal keys are collapsed into one run
+    // before sorting (see fordJohnsonStableOrderInto). Any integer in the
+    // key type's range is accepted. Like Sorter, a KeySorter shares nothing
+    // but its pool and can be cleared and loaded again.
+    class KeySorter {
+    public:
+        explicit KeySorter(e_key_type type, ThreadPool *pool = NULL);
+
+        void setPool(ThreadPool *pool);
+
+        // Appends the keys; empty strings are skipped with a warning.
+        bool load(const char *numList[]) _PMM_NOEXCEPT;
+        // Text as for Sorter::loadFile(); binary is raw little-endian
+        // 64-bit keys.
+        bool loadFile(const char *path, e_input_format format) _PMM_NOEXCEPT;
+        void clear(void);
+
+        void sort(void);
+
+        e_key_type type(void) const;
+        size_t size(void) const;
+        // The i-th key as given; read signed keys through int64_t.
+        uint64_t at(size_t i) const;
+        // Where the i-th key was in the input; after a sort, equal keys
+        // have increasing positions.
+        size_t position(size_t i) const;
+        KeySortStats const &stats(void) const;
+
+        void print(void) const _PMM_NOEXCEPT;
+        void printTime(void) const;
+
+    private:
+        e_key_type _type;
+        ThreadPool *_pool;
+        std::vector<uint64_t> _keys;      // ordered form: signed keys have the sign bit flipped
+        std::vector<uint64_t> _scratch;
+        std::vector<size_t> _positions;
+        std::vector<size_t> _order;
+        KeySortStats _stats;
+        FordJohnsonWorkspace<BlockedVector<size_t> > _workspace;
+
+        struct KeySink; // parses tokens into _keys
+
+        KeySorter(const KeySorter& other);
+        KeySorter& operator=(const KeySorter& rhs);
+    };
 
     bool testValidInputs(void);
     bool testEmptyInput(void);
@@ -45,12 +211,23 @@ namespace PmergeMe {
     bool testLargeNumbers(void);
     bool testOrderPreservation(void);
     bool testMixedValidInvalid(void);
+    bool testManyUniqueValues(void);
+    bool testManyValuesWithDuplicate(void);
+    bool testTextFileInput(void);
+    bool testBinaryFileInput(void);
+    bool testIndexedSkipList(void);
+    bool testBlockedVector(void);
+    bool testGenericSort(void);
+    bool testKeyPayloadSort(void);
+    bool testParallelSort(void);
+    bool testInstrumentedCompare(void);
+    bool testExternalSort(void);
+    bool testSortStrategy(void);
+    bool testSmallBaseCase(void);
+    bool testFordJohnsonProfile(void);
+    bool testConcurrentSorters(void);
+    bool testStableKeySort(void);
+    bool testPerfHarness(void);
 
     bool runAllTests(void) _PMM_PARSING_ONLY;
-
-    void mergeInsertionSortV(void);
-    void mergeInsertionSortL(void);
-
-    void printTimeV(void);
-    void printTimeL(void);
 }
\ No newline at end of file
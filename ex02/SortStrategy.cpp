@@ -0,0 +1,62 @@
+#include "SortStrategy.hpp"
+
+namespace PmergeMe {
+    namespace {
+        const char *_nsStrategyNames[] = { "auto", "merge-insertion", "radix", "introsort" };
+    }
+
+    const char *strategyName(e_sort_strategy strategy) {
+        return _nsStrategyNames[strategy];
+    }
+
+    bool parseStrategy(std::string const &name, e_sort_strategy &strategy) {
+        for (int i = STRATEGY_AUTO; i <= STRATEGY_INTROSORT; ++i) {
+            if (name == _nsStrategyNames[i]) {
+                strategy = static_cast<e_sort_strategy>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void radixSortNonNegative(std::vector<int> &values) {
+        enum { BITS = 11, BUCKETS = 1 << BITS, MASK = BUCKETS - 1, PASSES = 3 };
+        size_t n = values.size();
+        if (n < 2)
+            return;
+
+        std::vector<size_t> counts(PASSES * BUCKETS, 0);
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t key = static_cast<uint32_t>(values[i]);
+            ++counts[key & MASK];
+            ++counts[BUCKETS + ((key >> BITS) & MASK)];
+            ++counts[2 * BUCKETS + (key >> (2 * BITS))];
+        }
+
+        std::vector<int> scratch(n);
+        int *src = &values[0];
+        int *dst = &scratch[0];
+        for (int pass = 0; pass < PASSES; ++pass) {
+            size_t *count = &counts[pass * BUCKETS];
+            int shift = pass * BITS;
+            if (count[(static_cast<uint32_t>(src[0]) >> shift) & MASK] == n)
+                continue; // every value has this digit
+
+            size_t offset = 0;
+            for (int b = 0; b < BUCKETS; ++b) {
+                size_t c = count[b];
+                count[b] = offset;
+                offset += c;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                uint32_t key = static_cast<uint32_t>(src[i]);
+                dst[count[(key >> shift) & MASK]++] = src[i];
+            }
+            int *tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+        if (src != &values[0])
+            values.swap(scratch);
+    }
+}
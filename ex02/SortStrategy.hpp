@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "Perf.hpp"
+
+namespace PmergeMe {
+    enum e_sort_strategy {
+        STRATEGY_AUTO,
+        STRATEGY_MERGE_INSERTION, // fewest comparisons
+        STRATEGY_RADIX,           // no comparisons; non-negative int keys only
+        STRATEGY_INTROSORT        // std::sort
+    };
+
+    // Per-comparison cost above which merge-insertion's ~28% fewer
+    // comparisons outweigh its bookkeeping. Measured in the build that runs
+    // the choice, PmergeMe's own (no -O): PmergeMe_bench built with the same
+    // flags and --compare-cost puts the break-even near 180 ns a comparison
+    // at a thousand elements and 330 ns at a hundred thousand. Radix sort
+    // overtakes std::sort at about 224 random elements there, so below
+    // RADIX_MIN_ELEMENTS its histograms cost more than they save. Below
+    // TINY_ELEMENTS nothing is sampled and introsort is used. An optimized
+    // build crosses over sooner (75 ns and 512 elements at -O2).
+    enum {
+        STRATEGY_COMPARE_BREAK_EVEN_NS = 250,
+        STRATEGY_COMPARE_SAMPLES = 256,
+        STRATEGY_TINY_ELEMENTS = 32,
+        STRATEGY_RADIX_MIN_ELEMENTS = 256
+    };
+
+    struct StrategyChoice {
+        e_sort_strategy strategy;
+        const char *reason;
+        uint64_t compareNs; // sampled cost of one comparison; 0 if not sampled
+    };
+
+    const char *strategyName(e_sort_strategy strategy);
+    // Accepts the names strategyName() returns.
+    bool parseStrategy(std::string const &name, e_sort_strategy &strategy);
+
+    // LSD radix sort of non-negative ints: three passes of 11-bit digits,
+    // with all three histograms built in one read of the input. A pass
+    // whose digit is the same for every value is skipped. Scalar: the
+    // counting and scatter loops do not vectorize, and SIMD digit extraction
+    // into per-lane count tables measured slower than this.
+    void radixSortNonNegative(std::vector<int> &values);
+
+    // Picks the fastest strategy for sorting [first, last) with `comp`.
+    // `radixKeys` says the elements are non-negative ints ordered by value,
+    // so the radix sort may stand in for `comp`. The comparator's cost is
+    // measured on pairs sampled across the input.
+    template <typename RandomIt, typename Compare>
+    StrategyChoice chooseSortStrategy(RandomIt first, RandomIt last, Compare comp, bool radixKeys) {
+        StrategyChoice choice = { STRATEGY_INTROSORT, "", 0 };
+        size_t n = static_cast<size_t>(last - first);
+
+        if (n < STRATEGY_TINY_ELEMENTS) {
+            choice.reason = "tiny input";
+            return choice;
+        }
+
+        // At most a quarter of the elements, so sampling an expensive
+        // comparator costs a fraction of the sort. The first round brings
+        // the pairs into cache and the second is timed, less the cost of
+        // reading the clock, so neither is charged to the comparator.
+        size_t samples = std::min(n / 4, static_cast<size_t>(STRATEGY_COMPARE_SAMPLES));
+        size_t stride = n / samples;
+        size_t inOrder = 0;
+        uint64_t elapsed = 0;
+        for (int round = 0; round < 2; ++round) {
+            uint64_t clockStart = Perf::nowNs();
+            uint64_t start = Perf::nowNs();
+            for (size_t i = 0; i < samples; ++i)
+                inOrder += comp(first[i * stride], first[i * stride + 1]);
+            uint64_t end = Perf::nowNs();
+            uint64_t clockCost = start - clockStart;
+            elapsed = end - start > clockCost ? end - start - clockCost : 0;
+        }
+        volatile size_t keep = inOrder; // keeps the sampled calls from being dropped
+        (void)keep;
+
+        choice.compareNs = elapsed / samples;
+        if (choice.compareNs > STRATEGY_COMPARE_BREAK_EVEN_NS) {
+            choice.strategy = STRATEGY_MERGE_INSERTION;
+            choice.reason = "expensive comparisons, so the fewest comparisons win";
+        } else if (radixKeys && n >= STRATEGY_RADIX_MIN_ELEMENTS) {
+            choice.strategy = STRATEGY_RADIX;
+            choice.reason = "cheap comparisons on non-negative int keys, which radix sorts without comparing";
+        } else {
+            choice.reason = radixKeys ? "cheap comparisons on too few elements for radix passes"
+                                      : "cheap comparisons";
+        }
+        return choice;
+    }
+}
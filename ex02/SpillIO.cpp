@@ -0,0 +1,233 @@
+#include "SpillIO.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <cerrno>
+#include <unistd.h>
+
+namespace PmergeMe {
+    IoRequest::IoRequest()
+        : fd(-1), data(NULL), bytes(0), offset(0), write(false),
+          transferred(0), failed(false), finished(true) {}
+
+    IoWorker::IoWorker() : _thread(), _threaded(false), _queue(), _stopping(false) {
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_wake, NULL);
+        pthread_cond_init(&_done, NULL);
+        _threaded = pthread_create(&_thread, NULL, &IoWorker::workerMain_impl, this) == 0;
+    }
+
+    IoWorker::~IoWorker() {
+        if (_threaded) {
+            pthread_mutex_lock(&_mutex);
+            _stopping = true;
+            pthread_cond_signal(&_wake);
+            pthread_mutex_unlock(&_mutex);
+            pthread_join(_thread, NULL);
+        }
+        pthread_cond_destroy(&_done);
+        pthread_cond_destroy(&_wake);
+        pthread_mutex_destroy(&_mutex);
+    }
+
+    void IoWorker::submit(IoRequest &request) {
+        request.transferred = 0;
+        request.failed = false;
+        request.finished = false;
+        if (!_threaded) {
+            serve_impl(request);
+            request.finished = true;
+            return;
+        }
+        pthread_mutex_lock(&_mutex);
+        _queue.push_back(&request);
+        pthread_cond_signal(&_wake);
+        pthread_mutex_unlock(&_mutex);
+    }
+
+    bool IoWorker::wait(IoRequest &request) {
+        pthread_mutex_lock(&_mutex);
+        while (!request.finished)
+            pthread_cond_wait(&_done, &_mutex);
+        pthread_mutex_unlock(&_mutex);
+        return !request.failed;
+    }
+
+    void *IoWorker::workerMain_impl(void *self) {
+        IoWorker *io = static_cast<IoWorker *>(self);
+
+        pthread_mutex_lock(&io->_mutex);
+        while (true) {
+            while (!io->_stopping && io->_queue.empty())
+                pthread_cond_wait(&io->_wake, &io->_mutex);
+            if (io->_queue.empty())
+                break; // stopping, and nothing left to serve
+            IoRequest *request = io->_queue.front();
+            io->_queue.pop_front();
+            pthread_mutex_unlock(&io->_mutex);
+
+            serve_impl(*request);
+
+            pthread_mutex_lock(&io->_mutex);
+            request->finished = true;
+            pthread_cond_broadcast(&io->_done);
+        }
+        pthread_mutex_unlock(&io->_mutex);
+        return NULL;
+    }
+
+    void IoWorker::serve_impl(IoRequest &request) {
+        while (request.transferred < request.bytes) {
+            char *at = request.data + request.transferred;
+            size_t left = request.bytes - request.transferred;
+            off_t offset = request.offset + static_cast<off_t>(request.transferred);
+            ssize_t done = request.write ? pwrite(request.fd, at, left, offset)
+                                         : pread(request.fd, at, left, offset);
+            if (done < 0 && errno == EINTR)
+                continue;
+            if (done < 0 || (done == 0 && request.write)) {
+                request.failed = true;
+                return;
+            }
+            if (done == 0)
+                return; // end of file
+            request.transferred += static_cast<size_t>(done);
+        }
+    }
+
+    BlockWriter::BlockWriter(IoWorker &io, int fd, off_t offset, size_t blockBytes)
+        : _io(&io), _fd(fd), _offset(offset), _fill(0), _current(0), _failed(false) {
+        _blocks[0].resize(blockBytes);
+        _blocks[1].resize(blockBytes);
+    }
+
+    BlockWriter::~BlockWriter() {
+        _io->wait(_requests[0]);
+        _io->wait(_requests[1]);
+    }
+
+    void BlockWriter::append(const void *data, size_t bytes) {
+        const char *src = static_cast<const char *>(data);
+        while (bytes > 0) {
+            size_t room = _blocks[_current].size() - _fill;
+            size_t chunk = bytes < room ? bytes : room;
+            std::memcpy(&_blocks[_current][_fill], src, chunk);
+            _fill += chunk;
+            src += chunk;
+            bytes -= chunk;
+            if (_fill == _blocks[_current].size())
+                submit_impl();
+        }
+    }
+
+    bool BlockWriter::flush(void) {
+        if (_fill)
+            submit_impl();
+        _failed |= !_io->wait(_requests[0]);
+        _failed |= !_io->wait(_requests[1]);
+        return !_failed;
+    }
+
+    off_t BlockWriter::offset(void) const {
+        return _offset + static_cast<off_t>(_fill);
+    }
+
+    // Hands the current block to the worker and switches to the other one,
+    // once the write that last used it is done.
+    void BlockWriter::submit_impl(void) {
+        IoRequest &request = _requests[_current];
+        request.fd = _fd;
+        request.data = &_blocks[_current][0];
+        request.bytes = _fill;
+        request.offset = _offset;
+        request.write = true;
+        _io->submit(request);
+
+        _offset += static_cast<off_t>(_fill);
+        _fill = 0;
+        _current ^= 1;
+        _failed |= !_io->wait(_requests[_current]);
+    }
+
+    RunReader::RunReader(IoWorker &io, int fd, off_t begin, off_t end, size_t blockBytes)
+        : _io(&io), _fd(fd), _next(begin), _end(end), _blockBytes(blockBytes - blockBytes % sizeof(int)),
+          _current(0), _cursor(NULL), _limit(NULL), _failed(false) {
+        _blocks[0].resize(_blockBytes);
+        _blocks[1].resize(_blockBytes);
+        _pending[0] = false;
+        _pending[1] = false;
+        request_impl(0);
+        request_impl(1);
+    }
+
+    RunReader::~RunReader() {
+        _io->wait(_requests[0]);
+        _io->wait(_requests[1]);
+    }
+
+    bool RunReader::next(int &value) {
+        if (_cursor == _limit && !advance_impl())
+            return false;
+        std::memcpy(&value, _cursor, sizeof(int));
+        _cursor += sizeof(int);
+        return true;
+    }
+
+    bool RunReader::failed(void) const {
+        return _failed;
+    }
+
+    void RunReader::request_impl(int block) {
+        if (_next >= _end)
+            return;
+        size_t bytes = static_cast<size_t>(_end - _next);
+        if (bytes > _blockBytes)
+            bytes = _blockBytes;
+
+        IoRequest &request = _requests[block];
+        request.fd = _fd;
+        request.data = &_blocks[block][0];
+        request.bytes = bytes;
+        request.offset = _next;
+        request.write = false;
+        _io->submit(request);
+        _pending[block] = true;
+        _next += static_cast<off_t>(bytes);
+    }
+
+    // Moves to the block requested next, and asks for the one after it in
+    // the buffer just drained.
+    bool RunReader::advance_impl(void) {
+        if (_cursor != NULL) {
+            int drained = _current;
+            _current ^= 1;
+            request_impl(drained);
+        }
+        _cursor = NULL;
+        _limit = NULL;
+        if (!_pending[_current] || _failed)
+            return false;
+
+        IoRequest &request = _requests[_current];
+        _pending[_current] = false;
+        if (!_io->wait(request) || request.transferred != request.bytes) {
+            _failed = true;
+            return false;
+        }
+        _cursor = &_blocks[_current][0];
+        _limit = _cursor + request.transferred;
+        return _cursor != _limit;
+    }
+
+    int openSpillFile(void) {
+        const char *dir = std::getenv("TMPDIR");
+        std::string path = std::string(dir && *dir ? dir : "/tmp") + "/pmergeme_spill_XXXXXX";
+        std::vector<char> buf(path.begin(), path.end());
+        buf.push_back('\0');
+
+        int fd = mkstemp(&buf[0]);
+        if (fd >= 0)
+            unlink(&buf[0]);
+        return fd;
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <pthread.h>
+#include <sys/types.h>
+
+namespace PmergeMe {
+    // One positioned read or write, carried out by an IoWorker.
+    struct IoRequest {
+        int fd;
+        char *data;
+        size_t bytes;
+        off_t offset;
+        bool write;
+        size_t transferred; // a read may stop short at end of file
+        bool failed;
+        bool finished;
+
+        IoRequest();
+    };
+
+    // Background thread serving IoRequests in submission order, so the
+    // caller can sort or merge while the previous block is still on its way
+    // to (or from) the disk.
+    class IoWorker {
+    public:
+        IoWorker();
+        ~IoWorker();
+
+        void submit(IoRequest &request);
+        // Blocks until `request` has run; false if it failed.
+        bool wait(IoRequest &request);
+
+    private:
+        pthread_t _thread;
+        bool _threaded; // false if the thread could not start: serve inline
+        pthread_mutex_t _mutex;
+        pthread_cond_t _wake;
+        pthread_cond_t _done;
+        std::deque<IoRequest *> _queue;
+        bool _stopping;
+
+        static void *workerMain_impl(void *self);
+        static void serve_impl(IoRequest &request);
+
+        IoWorker(const IoWorker& other);
+        IoWorker& operator=(const IoWorker& rhs);
+    };
+
+    // Appends bytes at `offset` onwards through two blocks: one fills while
+    // the other is being written.
+    class BlockWriter {
+    public:
+        BlockWriter(IoWorker &io, int fd, off_t offset, size_t blockBytes);
+        ~BlockWriter();
+
+        void append(const void *data, size_t bytes);
+        // Writes out what is buffered and waits for it; false on any error.
+        bool flush(void);
+        off_t offset(void) const; // end of what was appended so far
+
+    private:
+        IoWorker *_io;
+        int _fd;
+        off_t _offset;
+        std::vector<char> _blocks[2];
+        IoRequest _requests[2];
+        size_t _fill;
+        int _current;
+        bool _failed;
+
+        void submit_impl(void);
+
+        BlockWriter(const BlockWriter& other);
+        BlockWriter& operator=(const BlockWriter& rhs);
+    };
+
+    // Reads the native ints stored in [begin, end) of a spill file, one
+    // block ahead of the consumer.
+    class RunReader {
+    public:
+        RunReader(IoWorker &io, int fd, off_t begin, off_t end, size_t blockBytes);
+        ~RunReader();
+
+        // The next value; false at the end of the run or on a read error.
+        bool next(int &value);
+        bool failed(void) const;
+
+    private:
+        IoWorker *_io;
+        int _fd;
+        off_t _next;    // where the next block to request starts
+        off_t _end;
+        size_t _blockBytes;
+        std::vector<char> _blocks[2];
+        IoRequest _requests[2];
+        bool _pending[2];
+        int _current;
+        const char *_cursor;
+        const char *_limit;
+        bool _failed;
+
+        void request_impl(int block);
+        bool advance_impl(void);
+
+        RunReader(const RunReader& other);
+        RunReader& operator=(const RunReader& rhs);
+    };
+
+    // Read-write temporary file under $TMPDIR (or /tmp), already unlinked so
+    // it disappears with the descriptor. Returns -1 on failure.
+    int openSpillFile(void);
+}
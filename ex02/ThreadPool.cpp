@@ -0,0 +1,99 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace PmergeMe {
+    ThreadPool::ThreadPool(size_t threads) : _workers(), _jobs(), _stopping(false) {
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_wake, NULL);
+        pthread_cond_init(&_done, NULL);
+
+        for (size_t i = 1; i < threads; ++i) {
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, &ThreadPool::workerMain_impl, this) != 0)
+                break; // run with the workers we got
+            _workers.push_back(thread);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        pthread_mutex_lock(&_mutex);
+        _stopping = true;
+        pthread_cond_broadcast(&_wake);
+        pthread_mutex_unlock(&_mutex);
+
+        for (size_t i = 0; i < _workers.size(); ++i)
+            pthread_join(_workers[i], NULL);
+
+        pthread_cond_destroy(&_done);
+        pthread_cond_destroy(&_wake);
+        pthread_mutex_destroy(&_mutex);
+    }
+
+    size_t ThreadPool::threadCount(void) const {
+        return _workers.size() + 1;
+    }
+
+    void ThreadPool::parallelFor(size_t count, RangeTask task, void *ctx) {
+        if (_workers.empty() || count < 2) {
+            if (count)
+                task(ctx, 0, count);
+            return;
+        }
+
+        // A few chunks per thread, so uneven chunks still balance out.
+        Job job;
+        job.task = task;
+        job.ctx = ctx;
+        job.count = count;
+        job.chunks = std::min(4 * threadCount(), count);
+        job.nextChunk = 0;
+        job.pending = job.chunks;
+
+        pthread_mutex_lock(&_mutex);
+        _jobs.push_back(&job);
+        pthread_cond_broadcast(&_wake);
+        while (job.nextChunk < job.chunks)
+            runChunk_impl(job);
+        while (job.pending > 0)
+            pthread_cond_wait(&_done, &_mutex);
+        pthread_mutex_unlock(&_mutex);
+    }
+
+    void *ThreadPool::workerMain_impl(void *self) {
+        ThreadPool *pool = static_cast<ThreadPool *>(self);
+
+        pthread_mutex_lock(&pool->_mutex);
+        while (true) {
+            while (!pool->_stopping && pool->_jobs.empty())
+                pthread_cond_wait(&pool->_wake, &pool->_mutex);
+            if (pool->_stopping)
+                break;
+            pool->runChunk_impl(*pool->_jobs.front());
+        }
+        pthread_mutex_unlock(&pool->_mutex);
+        return NULL;
+    }
+
+    void ThreadPool::runChunk_impl(Job &job) {
+        size_t chunk = claim_impl(job);
+        size_t begin = chunk * job.count / job.chunks;
+        size_t end = (chunk + 1) * job.count / job.chunks;
+
+        pthread_mutex_unlock(&_mutex);
+        job.task(job.ctx, begin, end);
+        pthread_mutex_lock(&_mutex);
+
+        if (--job.pending == 0)
+            pthread_cond_broadcast(&_done); // callers wait on different jobs
+    }
+
+    // Takes the job's next chunk; a job is dropped from the queue as soon
+    // as its last chunk is claimed, so it can leave the caller's stack once
+    // pending reaches zero.
+    size_t ThreadPool::claim_impl(Job &job) {
+        size_t chunk = job.nextChunk++;
+        if (job.nextChunk == job.chunks)
+            _jobs.erase(std::find(_jobs.begin(), _jobs.end(), &job));
+        return chunk;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <pthread.h>
+
+namespace PmergeMe {
+    // Fixed set of pthread workers for data-parallel loops. parallelFor()
+    // splits [0, count) into chunks that the workers and the calling thread
+    // claim one at a time, and returns once every chunk has run.
+    //
+    // Each call is a job of its own, so any number of threads may call
+    // parallelFor() at once (independent sorts sharing one pool), and a task
+    // may call it again. Workers serve jobs oldest first; a caller only runs
+    // chunks of its own job, then waits for those already claimed.
+    class ThreadPool {
+    public:
+        typedef void (*RangeTask)(void *ctx, size_t begin, size_t end);
+
+        explicit ThreadPool(size_t threads); // threads includes the caller
+        ~ThreadPool();
+
+        size_t threadCount(void) const;
+        void parallelFor(size_t count, RangeTask task, void *ctx);
+
+    private:
+        struct Job {
+            RangeTask task;
+            void *ctx;
+            size_t count;
+            size_t chunks;
+            size_t nextChunk;
+            size_t pending; // chunks not finished yet
+        };
+
+        std::vector<pthread_t> _workers;
+        pthread_mutex_t _mutex;
+        pthread_cond_t _wake;
+        pthread_cond_t _done;
+        std::deque<Job *> _jobs; // jobs with unclaimed chunks, oldest first
+        bool _stopping;
+
+        static void *workerMain_impl(void *self);
+        // Both run with _mutex held, and runChunk_impl() releases it while
+        // the task runs.
+        void runChunk_impl(Job &job);
+        size_t claim_impl(Job &job);
+
+        ThreadPool(const ThreadPool& other);
+        ThreadPool& operator=(const ThreadPool& rhs);
+    };
+}
@@ -0,0 +1,391 @@
+#include "FordJohnson.hpp"
+#include "ThreadPool.hpp"
+#include "InstrumentedCompare.hpp"
+#include "SortStrategy.hpp"
+#include "Perf.hpp"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <list>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <stdint.h>
+
+// Repeatable benchmark for the Ford-Johnson engines.
+//
+// Times the vector and list engines against std::sort, std::stable_sort, the
+// radix sort and the automatic strategy choice (auto) on generated inputs:
+// warm-up runs first, then N timed repetitions on a fresh copy of the input,
+// with a monotonic nanosecond clock. Reports min, median and p99, elements/s
+// at the median, and what one extra instrumented run saw: its comparisons next
+// to the ceil(log2(n!)) lower bound, and its time split between the comparator
+// and the sort's own bookkeeping. --compare-cost makes every comparison spin
+// for a while, standing in for an expensive comparator. Output is CSV, or JSON
+// in the shared perf report layout with each run's latency distribution. Exits
+// with 1 if any engine leaves its input unsorted.
+
+#define PRINT(X) std::cout << X
+#define ERRLOG(X) std::cerr << X
+#define __FLUSH() ; std::cout << std::endl
+
+namespace {
+    enum e_engine {
+        ENGINE_VECTOR,
+        ENGINE_LIST,
+        ENGINE_STD_SORT,
+        ENGINE_STD_STABLE_SORT,
+        ENGINE_RADIX,
+        ENGINE_AUTO,
+        ENGINE_COUNT
+    };
+
+    const char* _nsEngineNames[] = { "vector", "list", "std_sort", "std_stable_sort", "radix", "auto" };
+
+    enum e_distribution {
+        DIST_RANDOM,
+        DIST_SORTED,
+        DIST_REVERSED,
+        DIST_SAWTOOTH,
+        DIST_COUNT
+    };
+
+    const char* _nsDistributionNames[] = { "random", "sorted", "reversed", "sawtooth" };
+
+    struct Options {
+        std::vector<size_t> sizes;
+        std::vector<e_engine> engines;
+        std::vector<e_distribution> distributions;
+        size_t reps;
+        size_t warmups;
+        size_t threads;
+        uint64_t seed;
+        uint64_t compareCostNs;
+        bool json;
+    };
+
+    struct Result {
+        e_engine engine;
+        e_distribution distribution;
+        size_t n;
+        uint64_t minNs;
+        uint64_t medianNs;
+        uint64_t p99Ns;
+        double elementsPerSec;
+        size_t comparisons;
+        uint64_t compareNs;    // instrumented run: inside the comparator
+        uint64_t bookkeepingNs; // instrumented run: everything else
+        uint64_t lowerBound;
+        Perf::Samples latency; // the timed repetitions; min, median and p99 come from it
+    };
+
+    // int comparison that first spins for `costNs`, like a slow comparator.
+    struct BenchLess {
+        uint64_t costNs;
+
+        bool operator()(int a, int b) const {
+            if (costNs) {
+                uint64_t until = Perf::nowNs() + costNs;
+                while (Perf::nowNs() < until)
+                    ;
+            }
+            return a < b;
+        }
+    };
+
+    // ceil(log2(n!)), summed in long double: exact for the sizes benchmarked.
+    uint64_t __comparisonLowerBound(size_t n) {
+        long double bits = 0;
+        for (size_t k = 2; k <= n; ++k)
+            bits += std::log(static_cast<long double>(k));
+        bits /= std::log(2.0L);
+        return static_cast<uint64_t>(std::ceil(bits - 1e-9L));
+    }
+
+    // Sawtooth: ascending runs of about sqrt(n) values, repeating.
+    std::vector<int> __generate(e_distribution dist, size_t n, Perf::Rng& rng) {
+        std::vector<int> values(n);
+        size_t period = static_cast<size_t>(std::sqrt(static_cast<double>(n)));
+        if (period < 2)
+            period = 2;
+
+        for (size_t i = 0; i < n; ++i) {
+            switch (dist) {
+                case DIST_RANDOM:   values[i] = static_cast<int>(rng.next() >> 33); break;
+                case DIST_SORTED:   values[i] = static_cast<int>(i); break;
+                case DIST_REVERSED: values[i] = static_cast<int>(n - i); break;
+                default:            values[i] = static_cast<int>(i % period); break;
+            }
+        }
+        return values;
+    }
+
+    // One run of `engine` on a copy of `input` with `comp`; returns the
+    // elapsed ns and leaves the sorted output in `out`.
+    template <typename Compare>
+    uint64_t __runOnce(e_engine engine, std::vector<int> const& input, std::vector<int>& out,
+                       Compare comp, PmergeMe::ThreadPool* pool) {
+        uint64_t start;
+        uint64_t elapsed;
+
+        if (engine == ENGINE_LIST) {
+            std::list<int> lst(input.begin(), input.end());
+            start = Perf::nowNs();
+            PmergeMe::fordJohnsonSortList(lst, comp, PmergeMe::NoComparisonCount(), pool);
+            elapsed = Perf::nowNs() - start;
+            out.assign(lst.begin(), lst.end());
+            return elapsed;
+        }
+
+        out = input;
+        start = Perf::nowNs();
+        switch (engine) {
+            case ENGINE_VECTOR:
+                PmergeMe::fordJohnsonSort(out.begin(), out.end(), comp, PmergeMe::NoComparisonCount(), pool);
+                break;
+            case ENGINE_STD_SORT:
+                std::sort(out.begin(), out.end(), comp);
+                break;
+            case ENGINE_RADIX:
+                PmergeMe::radixSortNonNegative(out); // generated values are non-negative
+                break;
+            case ENGINE_AUTO:
+                switch (PmergeMe::chooseSortStrategy(out.begin(), out.end(), comp, true).strategy) {
+                    case PmergeMe::STRATEGY_RADIX:
+                        PmergeMe::radixSortNonNegative(out);
+                        break;
+                    case PmergeMe::STRATEGY_MERGE_INSERTION:
+                        PmergeMe::fordJohnsonSort(out.begin(), out.end(), comp, PmergeMe::NoComparisonCount(), pool);
+                        break;
+                    default:
+                        std::sort(out.begin(), out.end(), comp);
+                        break;
+                }
+                break;
+            default:
+                std::stable_sort(out.begin(), out.end(), comp);
+                break;
+        }
+        return Perf::nowNs() - start;
+    }
+
+    bool __benchmark(Options const& opt, e_engine engine, e_distribution dist, size_t n,
+                     PmergeMe::ThreadPool* pool, Result& result) {
+        Perf::Rng rng(opt.seed + n);
+        std::vector<int> input = __generate(dist, n, rng);
+        std::vector<int> expected(input);
+        std::vector<int> out;
+        BenchLess less = { opt.compareCostNs };
+        PmergeMe::ComparisonStats stats;
+
+        std::sort(expected.begin(), expected.end());
+
+        result.engine = engine;
+        result.distribution = dist;
+        result.n = n;
+        result.lowerBound = __comparisonLowerBound(n);
+
+        uint64_t total = __runOnce(engine, input, out,
+            PmergeMe::InstrumentedCompare<BenchLess>(less, stats), pool);
+        if (out != expected)
+            return false;
+        result.comparisons = stats.calls;
+        result.compareNs = stats.compareNs;
+        result.bookkeepingNs = total > stats.compareNs ? total - stats.compareNs : 0;
+
+        for (size_t i = 0; i < opt.warmups + opt.reps; ++i) {
+            uint64_t elapsed = __runOnce(engine, input, out, less, pool);
+            if (i >= opt.warmups)
+                result.latency.record(elapsed);
+        }
+        result.minNs = result.latency.min();
+        result.medianNs = result.latency.percentile(0.50);
+        result.p99Ns = result.latency.percentile(0.99);
+        result.elementsPerSec = result.medianNs ? n * 1e9 / result.medianNs : 0;
+        return true;
+    }
+
+    void __printCsvHeader() {
+        PRINT("engine,distribution,n,threads,reps,min_ns,median_ns,p99_ns,elements_per_s,"
+              "comparisons,lower_bound,comparison_ratio,compare_ns,bookkeeping_ns") __FLUSH();
+    }
+
+    void __printCsv(Options const& opt, Result const& r) {
+        char ratio[32];
+        std::snprintf(ratio, sizeof(ratio), "%.4f",
+                      r.lowerBound ? static_cast<double>(r.comparisons) / r.lowerBound : 0.0);
+        PRINT(_nsEngineNames[r.engine] << ',' << _nsDistributionNames[r.distribution] << ','
+              << r.n << ',' << opt.threads << ',' << opt.reps << ',' << r.minNs << ','
+              << r.medianNs << ',' << r.p99Ns << ',' << static_cast<uint64_t>(r.elementsPerSec) << ','
+              << r.comparisons << ',' << r.lowerBound << ',' << ratio << ','
+              << r.compareNs << ',' << r.bookkeepingNs) __FLUSH();
+    }
+
+    void __printJson(Options const& opt, std::vector<Result> const& results) {
+        Perf::JsonWriter json(std::cout);
+
+        Perf::beginReport(json, "PmergeMe_bench");
+        for (size_t i = 0; i < results.size(); ++i) {
+            Result const& r = results[i];
+            json.beginObject();
+            json.field("engine", _nsEngineNames[r.engine]);
+            json.field("distribution", _nsDistributionNames[r.distribution]);
+            json.field("n", r.n);
+            json.field("threads", opt.threads);
+            json.field("reps", opt.reps);
+            json.field("min_ns", r.minNs);
+            json.field("median_ns", r.medianNs);
+            json.field("p99_ns", r.p99Ns);
+            json.field("elements_per_s", static_cast<uint64_t>(r.elementsPerSec));
+            json.field("comparisons", r.comparisons);
+            json.field("lower_bound", r.lowerBound);
+            json.field("comparison_ratio", r.lowerBound ? static_cast<double>(r.comparisons) / r.lowerBound : 0.0);
+            json.field("compare_ns", r.compareNs);
+            json.field("bookkeeping_ns", r.bookkeepingNs);
+            json.field("latency", r.latency);
+            json.endObject();
+        }
+        Perf::endReport(json);
+        std::cout.flush();
+    }
+
+    void __usage() {
+        ERRLOG("Usage:\n");
+        ERRLOG("\tPmergeMe_bench [--sizes N,N,...] [--engines vector,list,std_sort,std_stable_sort,radix,auto]\n");
+        ERRLOG("\t               [--dist random,sorted,reversed,sawtooth] [--reps N] [--warmup N]\n");
+        ERRLOG("\t               [--threads N] [--seed N] [--format csv|json]\n");
+        ERRLOG("\t               [--compare-cost NS]") << std::endl;
+    }
+
+    // Index of `name` in `names`, or -1.
+    int __lookup(std::string const& name, const char* names[], int count) {
+        for (int i = 0; i < count; ++i) {
+            if (name == names[i])
+                return i;
+        }
+        return -1;
+    }
+
+    std::vector<std::string> __splitList(const char* val) {
+        std::vector<std::string> items;
+        std::istringstream iss(val);
+        std::string item;
+        while (std::getline(iss, item, ','))
+            items.push_back(item);
+        return items;
+    }
+
+    bool __parseOptions(int argc, char* argv[], Options& opt) {
+        opt.reps = 11;
+        opt.warmups = 2;
+        opt.threads = 1;
+        opt.seed = 42;
+        opt.compareCostNs = 0;
+        opt.json = false;
+
+        for (int i = 1; i < argc; ++i) {
+            std::string flag = argv[i];
+            if (i + 1 >= argc)
+                return false;
+            const char* val = argv[++i];
+            char* end = NULL;
+
+            if (flag == "--format") {
+                if (std::string(val) != "csv" && std::string(val) != "json")
+                    return false;
+                opt.json = std::string(val) == "json";
+                continue;
+            }
+            if (flag == "--engines" || flag == "--dist") {
+                std::vector<std::string> names = __splitList(val);
+                for (size_t j = 0; j < names.size(); ++j) {
+                    int idx = flag == "--engines"
+                        ? __lookup(names[j], _nsEngineNames, ENGINE_COUNT)
+                        : __lookup(names[j], _nsDistributionNames, DIST_COUNT);
+                    if (idx < 0)
+                        return false;
+                    if (flag == "--engines")
+                        opt.engines.push_back(static_cast<e_engine>(idx));
+                    else
+                        opt.distributions.push_back(static_cast<e_distribution>(idx));
+                }
+                continue;
+            }
+            if (flag == "--sizes") {
+                std::vector<std::string> sizes = __splitList(val);
+                for (size_t j = 0; j < sizes.size(); ++j) {
+                    unsigned long long n = std::strtoull(sizes[j].c_str(), &end, 10);
+                    if (sizes[j].empty() || *end != '\0')
+                        return false;
+                    opt.sizes.push_back(n);
+                }
+                continue;
+            }
+
+            unsigned long long n = std::strtoull(val, &end, 10);
+            if (*val == '\0' || *end != '\0')
+                return false;
+            if (flag == "--reps") opt.reps = n ? n : 1;
+            else if (flag == "--warmup") opt.warmups = n;
+            else if (flag == "--threads") opt.threads = n ? n : 1;
+            else if (flag == "--seed") opt.seed = n;
+            else if (flag == "--compare-cost") opt.compareCostNs = n;
+            else return false;
+        }
+
+        if (opt.sizes.empty()) {
+            opt.sizes.push_back(1000);
+            opt.sizes.push_back(10000);
+            opt.sizes.push_back(100000);
+        }
+        if (opt.engines.empty()) {
+            for (int e = 0; e < ENGINE_COUNT; ++e)
+                opt.engines.push_back(static_cast<e_engine>(e));
+        }
+        if (opt.distributions.empty()) {
+            for (int d = 0; d < DIST_COUNT; ++d)
+                opt.distributions.push_back(static_cast<e_distribution>(d));
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!__parseOptions(argc, argv, opt)) {
+        __usage();
+        return 2;
+    }
+
+    PmergeMe::ThreadPool* pool = opt.threads > 1 ? new PmergeMe::ThreadPool(opt.threads) : NULL;
+    std::vector<Result> results;
+    bool sorted = true;
+
+    if (!opt.json)
+        __printCsvHeader();
+    for (size_t s = 0; s < opt.sizes.size(); ++s) {
+        for (size_t d = 0; d < opt.distributions.size(); ++d) {
+            for (size_t e = 0; e < opt.engines.size(); ++e) {
+                Result r;
+                if (!__benchmark(opt, opt.engines[e], opt.distributions[d], opt.sizes[s], pool, r)) {
+                    ERRLOG(_nsEngineNames[opt.engines[e]] << " left " << _nsDistributionNames[opt.distributions[d]]
+                           << " input of size " << opt.sizes[s] << " unsorted") << std::endl;
+                    sorted = false;
+                    continue;
+                }
+                if (opt.json)
+                    results.push_back(r);
+                else
+                    __printCsv(opt, r);
+            }
+        }
+    }
+    if (opt.json)
+        __printJson(opt, results);
+
+    delete pool;
+    return sorted ? 0 : 1;
+}
@@ -1,4 +1,71 @@
 #include "PmergeMe.hpp"
+#include "Perf.hpp"
+#include <string>
+#include <cstdlib>
+#include <fstream>
+
+#if !defined(_PMM_UNIT_TEST)
+// "4096", "64K", "512M" or "2G" as a byte count; 0 if malformed.
+static size_t parseByteCount(const char *text) {
+	char *end;
+	unsigned long long n = std::strtoull(text, &end, 10);
+	if (*text < '0' || *text > '9' || end == text)
+		return 0;
+	unsigned long long scale = 1;
+	if (*end == 'K' || *end == 'k') scale = 1ULL << 10;
+	else if (*end == 'M' || *end == 'm') scale = 1ULL << 20;
+	else if (*end == 'G' || *end == 'g') scale = 1ULL << 30;
+	if (scale != 1)
+		++end;
+	if (*end != '\0' || n > static_cast<size_t>(-1) / scale)
+		return 0;
+	return static_cast<size_t>(n * scale);
+}
+
+// The vector and list sorts' profiles as a perf report, one result each.
+static bool writeProfile(const char *path, PmergeMe::Sorter const &sorter) {
+	std::ofstream out(path);
+	Perf::JsonWriter json(out);
+	Perf::beginReport(json, "PmergeMe");
+	json.beginObject().field("container", "vector");
+	json.key("profile");
+	sorter.profileV().writeJson(json);
+	json.endObject();
+	json.beginObject().field("container", "list");
+	json.key("profile");
+	sorter.profileL().writeJson(json);
+	json.endObject();
+	Perf::endReport(json);
+	out.close();
+	if (!out) {
+		ERRLOG("Error: `" << path << "`: could not write the profile.") __ERRFLUSH();
+		return false;
+	}
+	return true;
+}
+
+// --keys: the stable 64-bit key sort, on argv[1..] as for the int sort.
+static int sortKeys(PmergeMe::e_key_type type, int argc, char *argv[], PmergeMe::ThreadPool *pool) {
+	PmergeMe::KeySorter sorter(type, pool);
+	std::string source = argc > 1 ? argv[1] : "";
+	bool loaded;
+
+	if (argc == 3 && (source == "--file" || source == "--binary"))
+		loaded = sorter.loadFile(argv[2], source == "--file" ? PmergeMe::TEXT_INPUT : PmergeMe::BINARY_INPUT);
+	else
+		loaded = sorter.load(const_cast<const char**>(argv + 1));
+	if (!loaded)
+		return 1;
+
+	PRINT("Before: "); sorter.print();
+	sorter.sort();
+	PRINT("After: "); sorter.print();
+#	if !defined(_PMM_ASSERT_TEST)
+		sorter.printTime();
+#	endif
+	return 0;
+}
+#endif
 
 int main(int argc, char *argv[]) {
 #if defined(_PMM_UNIT_TEST)
@@ -6,31 +73,136 @@ int main(int argc, char *argv[]) {
 	PmergeMe::runAllTests();
 	PRINT("Congratulations! All test cases have passed!") __FLUSH();
 #else
+	size_t threads = 1;
+	if (argc >= 3 && std::string(argv[1]) == "--threads") {
+		char *end;
+		long n = std::strtol(argv[2], &end, 10);
+		if (*argv[2] == '\0' || *end != '\0' || n < 1 || n > 256) {
+			ERRLOG("Error: `" << argv[2] << "`: thread count must be between 1 and 256.") __ERRFLUSH();
+			return 2;
+		}
+		threads = static_cast<size_t>(n);
+		argv += 2;
+		argc -= 2;
+	}
+
+	if (argc >= 3 && std::string(argv[1]) == "--keys") {
+		std::string type = argv[2];
+		if (type != "i64" && type != "u64") {
+			ERRLOG("Error: `" << argv[2] << "`: key type must be i64 or u64.") __ERRFLUSH();
+			return 2;
+		}
+		if (argc < 4) {
+			ERRLOG("Error: Not enough arguments") __ERRFLUSH();
+			return 2;
+		}
+		PmergeMe::ThreadPool *pool = threads > 1 ? new PmergeMe::ThreadPool(threads) : NULL;
+		int status = sortKeys(type == "i64" ? PmergeMe::SIGNED_KEYS : PmergeMe::UNSIGNED_KEYS, argc - 2, argv + 2, pool);
+		delete pool;
+		return status;
+	}
+
+	PmergeMe::e_sort_strategy strategy = PmergeMe::STRATEGY_AUTO;
+	bool strategyGiven = false;
+	if (argc >= 3 && std::string(argv[1]) == "--strategy") {
+		if (!PmergeMe::parseStrategy(argv[2], strategy)) {
+			ERRLOG("Error: `" << argv[2] << "`: strategy must be auto, merge-insertion, radix or introsort.") __ERRFLUSH();
+			return 2;
+		}
+		strategyGiven = true;
+		argv += 2;
+		argc -= 2;
+	}
+
+	const char *profilePath = NULL;
+	if (argc >= 3 && std::string(argv[1]) == "--profile") {
+#	if !defined(_PMM_PROFILE)
+		ERRLOG("Error: --profile needs a build with profiling hooks (make profile).") __ERRFLUSH();
+		return 2;
+#	endif
+		profilePath = argv[2];
+		argv += 2;
+		argc -= 2;
+	}
+
+	size_t budget = 0;
+	if (argc >= 3 && std::string(argv[1]) == "--external") {
+		budget = parseByteCount(argv[2]);
+		if (budget < PmergeMe::EXTERNAL_MIN_BUDGET) {
+			ERRLOG("Error: `" << argv[2] << "`: memory budget must be at least 64K.") __ERRFLUSH();
+			return 2;
+		}
+		argv += 2;
+		argc -= 2;
+		if (profilePath || argc != 4 || (std::string(argv[1]) != "--file" && std::string(argv[1]) != "--binary")) {
+			ERRLOG("Usage:\n\tPmergeMe [--threads N] --external <bytes>[K|M|G] --file|--binary <in> <out>") __ERRFLUSH();
+			return 2;
+		}
+	}
+
 	if (argc < 2) {
 		ERRLOG("Error: Not enough arguments") __ERRFLUSH();
-		ERRLOG("Usage:\n\tRPN x1 x2 ... xn") __ERRFLUSH();
+		ERRLOG("Usage:\n\tPmergeMe [--threads N] [--strategy S] [--profile <json>] x1 x2 ... xn") __ERRFLUSH();
+		ERRLOG("\tPmergeMe [--threads N] [--strategy S] [--profile <json>] --file <path>     (whitespace-separated integers)") __ERRFLUSH();
+		ERRLOG("\tPmergeMe [--threads N] [--strategy S] [--profile <json>] --binary <path>   (little-endian int32)") __ERRFLUSH();
+		ERRLOG("\tPmergeMe [--threads N] --external <bytes>[K|M|G] --file|--binary <in> <out>") __ERRFLUSH();
+		ERRLOG("\t                                         (out-of-core, sorted values to <out>)") __ERRFLUSH();
+		ERRLOG("\tPmergeMe [--threads N] --keys i64|u64 x1 x2 ... xn | --file <path> | --binary <path>") __ERRFLUSH();
+		ERRLOG("\t                                         (stable, duplicates allowed; binary is little-endian 64-bit)") __ERRFLUSH();
+		ERRLOG("\tS: auto (default), merge-insertion, radix or introsort; the std::vector sort only") __ERRFLUSH();
+		ERRLOG("\t--profile: per-level merge-insertion profile to <json>; `make profile` builds only") __ERRFLUSH();
 		return 2;
 	}
 
-	const char **numList = const_cast<const char**>(argv + 1);
+	PmergeMe::ThreadPool *pool = threads > 1 ? new PmergeMe::ThreadPool(threads) : NULL;
+	PmergeMe::Sorter sorter(pool);
+
+	if (budget) {
+		PmergeMe::e_input_format format = std::string(argv[1]) == "--file" ? PmergeMe::TEXT_INPUT : PmergeMe::BINARY_INPUT;
+		bool sorted = sorter.sortFile(argv[2], format, argv[3], budget);
+		delete pool;
+		if (!sorted)
+			return 1;
+		sorter.printTimeExternal();
+		return 0;
+	}
+
+	std::string source = argv[1];
+	bool loaded;
 
-	if (!PmergeMe::initInternals(numList))
+	if (argc == 3 && (source == "--file" || source == "--binary")) {
+		PmergeMe::e_input_format format = source == "--file" ? PmergeMe::TEXT_INPUT : PmergeMe::BINARY_INPUT;
+		loaded = sorter.loadFile(argv[2], format);
+	} else {
+		const char **numList = const_cast<const char**>(argv + 1);
+		loaded = sorter.load(numList);
+	}
+
+	if (!loaded) {
+		delete pool;
 		return 1;
+	}
 	
-	PRINT("Before: "); PmergeMe::printInternalV();
+	PRINT("Before: "); sorter.printV();
 
-	PmergeMe::mergeInsertionSortV();
-	PmergeMe::mergeInsertionSortL();
+	if (strategyGiven)
+		sorter.setStrategy(strategy);
+	sorter.sort();
 
 #	if defined(_PMM_ASSERT_TEST)
-		PRINT("After (vector): "); PmergeMe::printInternalV();
-		PRINT("After (list): "); PmergeMe::printInternalL();
+		PRINT("After (vector): "); sorter.printV();
+		PRINT("After (list): "); sorter.printL();
 #	else
-		PRINT("After: "); PmergeMe::printInternalV();
-		PmergeMe::printTimeV();
-		PmergeMe::printTimeL();
+		PRINT("After: "); sorter.printV();
+		sorter.printTimeV();
+		sorter.printTimeL();
+		sorter.printStrategyV();
 #	endif
 
+	bool profiled = !profilePath || writeProfile(profilePath, sorter);
+	delete pool;
+	if (!profiled)
+		return 1;
 #endif
 	return 0;
 }
@@ -0,0 +1,313 @@
+#include "Perf.hpp"
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+namespace Perf {
+    Counters::Counters(const char *const names[], size_t count) : _names(names), _values(count, 0) {}
+
+    size_t Counters::size(void) const {
+        return _values.size();
+    }
+
+    const char *Counters::name(size_t id) const {
+        return _names[id];
+    }
+
+    void Counters::clear(void) {
+        _values.assign(_values.size(), 0);
+    }
+
+    PhaseTimes::PhaseTimes(const char *const names[], size_t count)
+        : _names(names), _ns(count, 0), _entries(count, 0) {}
+
+    uint64_t PhaseTimes::totalNs(size_t id) const {
+        return _ns[id];
+    }
+
+    uint64_t PhaseTimes::entries(size_t id) const {
+        return _entries[id];
+    }
+
+    size_t PhaseTimes::size(void) const {
+        return _ns.size();
+    }
+
+    const char *PhaseTimes::name(size_t id) const {
+        return _names[id];
+    }
+
+    void PhaseTimes::clear(void) {
+        _ns.assign(_ns.size(), 0);
+        _entries.assign(_entries.size(), 0);
+    }
+
+    Histogram::Histogram() {
+        clear();
+    }
+
+    void Histogram::clear(void) {
+        for (size_t b = 0; b < BUCKETS; ++b)
+            _buckets[b] = 0;
+        _count = 0;
+        _sum = 0;
+        _min = ~0ULL;
+        _max = 0;
+    }
+
+    uint64_t Histogram::count(void) const {
+        return _count;
+    }
+
+    uint64_t Histogram::min(void) const {
+        return _count ? _min : 0;
+    }
+
+    uint64_t Histogram::max(void) const {
+        return _max;
+    }
+
+    double Histogram::mean(void) const {
+        return _count ? static_cast<double>(_sum) / _count : 0.0;
+    }
+
+    uint64_t Histogram::percentile(double p) const {
+        if (_count == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(p * _count));
+        if (rank < 1)
+            rank = 1;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            seen += _buckets[b];
+            if (seen >= rank)
+                return bucketUpper(b) < _max ? bucketUpper(b) : _max;
+        }
+        return _max;
+    }
+
+    uint64_t Histogram::bucketCount(size_t bucket) const {
+        return _buckets[bucket];
+    }
+
+    uint64_t Histogram::bucketUpper(size_t bucket) {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+        int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+        uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+        return lower + ((1ULL << shift) - 1);
+    }
+
+    Samples::Samples() : _values(), _sorted(true), _histogram() {}
+
+    void Samples::clear(void) {
+        _values.clear();
+        _sorted = true;
+        _histogram.clear();
+    }
+
+    uint64_t Samples::count(void) const {
+        return _values.size();
+    }
+
+    uint64_t Samples::min(void) const {
+        return _histogram.min();
+    }
+
+    uint64_t Samples::max(void) const {
+        return _histogram.max();
+    }
+
+    double Samples::mean(void) const {
+        return _histogram.mean();
+    }
+
+    uint64_t Samples::percentile(double p) const {
+        if (_values.empty())
+            return 0;
+        if (!_sorted) {
+            std::sort(_values.begin(), _values.end());
+            _sorted = true;
+        }
+        size_t rank = static_cast<size_t>(std::ceil(p * _values.size()));
+        if (rank < 1)
+            rank = 1;
+        if (rank > _values.size())
+            rank = _values.size();
+        return _values[rank - 1];
+    }
+
+    Histogram const &Samples::histogram(void) const {
+        return _histogram;
+    }
+
+    JsonWriter::JsonWriter(std::ostream &out) : _out(out), _empty(), _afterKey(false) {}
+
+    void JsonWriter::separator_impl(void) {
+        if (_afterKey) {
+            _afterKey = false;
+            return;
+        }
+        if (!_empty.empty()) {
+            if (!_empty.back())
+                _out << ", ";
+            _empty.back() = false;
+        }
+    }
+
+    JsonWriter &JsonWriter::open_impl(char bracket) {
+        separator_impl();
+        _out << bracket;
+        _empty.push_back(true);
+        return *this;
+    }
+
+    JsonWriter &JsonWriter::close_impl(char bracket) {
+        _empty.pop_back();
+        _out << bracket;
+        if (_empty.empty())
+            _out << '\n';
+        return *this;
+    }
+
+    JsonWriter &JsonWriter::beginObject(void) {
+        return open_impl('{');
+    }
+
+    JsonWriter &JsonWriter::endObject(void) {
+        return close_impl('}');
+    }
+
+    JsonWriter &JsonWriter::beginArray(void) {
+        return open_impl('[');
+    }
+
+    JsonWriter &JsonWriter::endArray(void) {
+        return close_impl(']');
+    }
+
+    JsonWriter &JsonWriter::key(const char *name) {
+        value(name);
+        _out << ": ";
+        _afterKey = true;
+        return *this;
+    }
+
+    JsonWriter &JsonWriter::value(double n) {
+        separator_impl();
+        if (n != n || n - n != 0) { // NaN or infinite
+            _out << "null";
+            return *this;
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.6g", n);
+        _out << buf;
+        return *this;
+    }
+
+    JsonWriter &JsonWriter::value(bool b) {
+        separator_impl();
+        _out << (b ? "true" : "false");
+        return *this;
+    }
+
+    JsonWriter &JsonWriter::value(const char *s) {
+        separator_impl();
+        _out << '"';
+        for (; *s; ++s) {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\') {
+                _out << '\\' << *s;
+            } else if (c < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                _out << buf;
+            } else {
+                _out << *s;
+            }
+        }
+        _out << '"';
+        return *this;
+    }
+
+    JsonWriter &JsonWriter::value(std::string const &s) {
+        return value(s.c_str());
+    }
+
+    JsonWriter &JsonWriter::value(Counters const &counters) {
+        beginObject();
+        for (size_t i = 0; i < counters.size(); ++i)
+            field(counters.name(i), counters.value(i));
+        return endObject();
+    }
+
+    JsonWriter &JsonWriter::value(PhaseTimes const &phases) {
+        beginObject();
+        for (size_t i = 0; i < phases.size(); ++i) {
+            key(phases.name(i)).beginObject();
+            field("ns", phases.totalNs(i));
+            field("entries", phases.entries(i));
+            endObject();
+        }
+        return endObject();
+    }
+
+    JsonWriter &JsonWriter::value(Histogram const &histogram) {
+        beginObject();
+        field("count", histogram.count());
+        field("min", histogram.min());
+        field("max", histogram.max());
+        field("mean", histogram.mean());
+        buckets_impl(histogram);
+        return endObject();
+    }
+
+    JsonWriter &JsonWriter::value(Samples const &samples) {
+        beginObject();
+        field("count", samples.count());
+        field("min", samples.min());
+        field("max", samples.max());
+        field("mean", samples.mean());
+        field("p50", samples.percentile(0.50));
+        field("p90", samples.percentile(0.90));
+        field("p99", samples.percentile(0.99));
+        field("p999", samples.percentile(0.999));
+        buckets_impl(samples.histogram());
+        return endObject();
+    }
+
+    void JsonWriter::buckets_impl(Histogram const &histogram) {
+        key("buckets").beginArray();
+        for (size_t b = 0; b < Histogram::BUCKETS; ++b) {
+            if (histogram.bucketCount(b) == 0)
+                continue;
+            beginArray();
+            value(Histogram::bucketUpper(b));
+            value(histogram.bucketCount(b));
+            endArray();
+        }
+        endArray();
+    }
+
+    void beginReport(JsonWriter &json, const char *program) {
+        json.beginObject();
+        json.field("schema", "perf/1");
+        json.field("program", program);
+#if defined(__VERSION__)
+        json.field("compiler", __VERSION__);
+#else
+        json.field("compiler", "unknown");
+#endif
+#if defined(__OPTIMIZE__)
+        json.field("optimized", true);
+#else
+        json.field("optimized", false);
+#endif
+        json.key("results").beginArray();
+    }
+
+    void endReport(JsonWriter &json) {
+        json.endArray();
+        json.endObject();
+    }
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Measurement harness shared by the btc, RPN and PmergeMe benchmarks: one
+// clock, phase timers, counters, latency histograms and one JSON report
+// layout, so numbers from the three programs and from different builds
+// line up.
+namespace Perf {
+    // Monotonic nanoseconds since an arbitrary start.
+    inline uint64_t nowNs(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    // xorshift64*: small, fast and identical on every platform, so a seed
+    // reproduces the same generated input everywhere.
+    class Rng {
+    public:
+        explicit Rng(uint64_t seed) : _s(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+        uint64_t next(void) {
+            _s ^= _s >> 12;
+            _s ^= _s << 25;
+            _s ^= _s >> 27;
+            return _s * 2685821657736338717ULL;
+        }
+        // Uniform enough below n for test inputs; 0 when n is 0.
+        uint64_t below(uint64_t n) { return n ? next() % n : 0; }
+
+    private:
+        uint64_t _s;
+    };
+
+    // Named counters picked by index, typically an enum of the caller's:
+    // add() is one addition, with no lookup or allocation. `names` must
+    // outlive the counters.
+    class Counters {
+    public:
+        Counters(const char *const names[], size_t count);
+
+        void add(size_t id, uint64_t n = 1) { _values[id] += n; }
+        uint64_t value(size_t id) const { return _values[id]; }
+        size_t size(void) const;
+        const char *name(size_t id) const;
+        void clear(void);
+
+    private:
+        const char *const *_names;
+        std::vector<uint64_t> _values;
+    };
+
+    // Time spent in each named phase, and how often it was entered; see
+    // ScopedPhase. Indexed like Counters.
+    class PhaseTimes {
+    public:
+        PhaseTimes(const char *const names[], size_t count);
+
+        void add(size_t id, uint64_t ns) {
+            _ns[id] += ns;
+            ++_entries[id];
+        }
+        uint64_t totalNs(size_t id) const;
+        uint64_t entries(size_t id) const;
+        size_t size(void) const;
+        const char *name(size_t id) const;
+        void clear(void);
+
+    private:
+        const char *const *_names;
+        std::vector<uint64_t> _ns;
+        std::vector<uint64_t> _entries;
+    };
+
+    // Charges its own lifetime to one phase.
+    class ScopedPhase {
+    public:
+        ScopedPhase(PhaseTimes &phases, size_t id) : _phases(phases), _id(id), _start(nowNs()) {}
+        ~ScopedPhase() { _phases.add(_id, nowNs() - _start); }
+
+    private:
+        PhaseTimes &_phases;
+        size_t _id;
+        uint64_t _start;
+
+        ScopedPhase(const ScopedPhase &other);
+        ScopedPhase &operator=(const ScopedPhase &rhs);
+    };
+
+    // Latencies, or any non-negative values, in log-scale buckets: values
+    // below SUB_BUCKETS get a bucket each, and every power of two above is
+    // split into SUB_BUCKETS equal steps. Recording is a few instructions
+    // and never allocates; a percentile is off by less than one step, at
+    // most 1/SUB_BUCKETS of the value. That is fine for the shape of a
+    // distribution but too coarse to compare builds on; use Samples for
+    // reported percentiles.
+    class Histogram {
+    public:
+        enum {
+            SUB_BUCKET_BITS = 3,
+            SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+            BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+        };
+
+        Histogram();
+
+        void record(uint64_t value) {
+            ++_buckets[bucketOf(value)];
+            ++_count;
+            _sum += value;
+            if (value < _min)
+                _min = value;
+            if (value > _max)
+                _max = value;
+        }
+        void clear(void);
+
+        uint64_t count(void) const;
+        uint64_t min(void) const; // 0 when empty
+        uint64_t max(void) const;
+        double mean(void) const;
+        // The highest value the bucket holding the p-quantile (0 to 1) can
+        // hold, capped at max().
+        uint64_t percentile(double p) const;
+
+        uint64_t bucketCount(size_t bucket) const;
+        static uint64_t bucketUpper(size_t bucket);
+
+        static size_t bucketOf(uint64_t value) {
+            if (value < SUB_BUCKETS)
+                return static_cast<size_t>(value);
+            int exponent = 63 - __builtin_clzll(value);
+            size_t sub = static_cast<size_t>(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+            return static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+        }
+
+    private:
+        uint64_t _buckets[BUCKETS];
+        uint64_t _count;
+        uint64_t _sum;
+        uint64_t _min;
+        uint64_t _max;
+    };
+
+    // Every value recorded, for exact order statistics, plus a Histogram of
+    // them for the distribution. percentile() is nearest-rank, so it is
+    // always a measured value. Meant for the repetitions or per-item timings
+    // of one benchmark run, not for unbounded streams.
+    class Samples {
+    public:
+        Samples();
+
+        void record(uint64_t value) {
+            _values.push_back(value);
+            _sorted = false;
+            _histogram.record(value);
+        }
+        void clear(void);
+
+        uint64_t count(void) const;
+        uint64_t min(void) const; // 0 when empty
+        uint64_t max(void) const;
+        double mean(void) const;
+        // The smallest sample with at least a p share (0 to 1) of the
+        // samples at or below it; 0 when empty.
+        uint64_t percentile(double p) const;
+        Histogram const &histogram(void) const;
+
+    private:
+        mutable std::vector<uint64_t> _values; // sorted lazily by percentile()
+        mutable bool _sorted;
+        Histogram _histogram;
+    };
+
+    // Streams JSON, keeping track of commas and nesting: inside an object
+    // every value follows a key(). Strings are escaped; non-finite doubles
+    // become null.
+    class JsonWriter {
+    public:
+        explicit JsonWriter(std::ostream &out);
+
+        JsonWriter &beginObject(void);
+        JsonWriter &endObject(void);
+        JsonWriter &beginArray(void);
+        JsonWriter &endArray(void);
+        JsonWriter &key(const char *name);
+
+        JsonWriter &value(int n) { return raw_impl(n); }
+        JsonWriter &value(unsigned n) { return raw_impl(n); }
+        JsonWriter &value(long n) { return raw_impl(n); }
+        JsonWriter &value(unsigned long n) { return raw_impl(n); }
+        JsonWriter &value(long long n) { return raw_impl(n); }
+        JsonWriter &value(unsigned long long n) { return raw_impl(n); }
+        JsonWriter &value(double n);
+        JsonWriter &value(bool b);
+        JsonWriter &value(const char *s);
+        JsonWriter &value(std::string const &s);
+        // {"name": value, ...}
+        JsonWriter &value(Counters const &counters);
+        // {"name": {"ns": total, "entries": n}, ...}
+        JsonWriter &value(PhaseTimes const &phases);
+        // Exact summary, and the non-empty buckets as [upper, count].
+        JsonWriter &value(Histogram const &histogram);
+        // The same, plus exact p50, p90, p99 and p999.
+        JsonWriter &value(Samples const &samples);
+
+        template <typename T>
+        JsonWriter &field(const char *name, T const &v) {
+            key(name);
+            return value(v);
+        }
+
+    private:
+        std::ostream &_out;
+        std::vector<bool> _empty; // per open container: nothing in it yet
+        bool _afterKey;
+
+        void separator_impl(void);
+        JsonWriter &open_impl(char bracket);
+        JsonWriter &close_impl(char bracket);
+        void buckets_impl(Histogram const &histogram);
+
+        template <typename T>
+        JsonWriter &raw_impl(T const &v) {
+            separator_impl();
+            _out << v;
+            return *this;
+        }
+
+        JsonWriter(const JsonWriter &other);
+        JsonWriter &operator=(const JsonWriter &rhs);
+    };
+
+    // The report layout every benchmark writes:
+    //   {"schema": "perf/1", "program": ..., "compiler": ..., "optimized": ...,
+    //    "results": [ one object per measurement ]}
+    // beginReport() leaves the results array open and endReport() closes it.
+    void beginReport(JsonWriter &json, const char *program);
+    void endReport(JsonWriter &json);
+}